@@ -0,0 +1,286 @@
+// ---------------------------------------------------------------------------------------------------
+// MODERNDBS
+// ---------------------------------------------------------------------------------------------------
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+#include "moderndbs/buffer_manager.h"
+#include "benchmark/benchmark.h"
+// ---------------------------------------------------------------------------------------------------
+using BufferManager = moderndbs::BufferManager;
+// ---------------------------------------------------------------------------------------------------
+namespace {
+// ---------------------------------------------------------------------------------------------------
+constexpr size_t PAGE_SIZE = 64;
+// ---------------------------------------------------------------------------------------------------
+/// Fixes every page once so that the whole pool is resident.
+void warmUp(BufferManager& buffer_manager, uint64_t page_count) {
+    for (uint64_t page_id = 0; page_id < page_count; ++page_id) {
+        auto& page = buffer_manager.fix_page(page_id, false);
+        buffer_manager.unfix_page(page, false);
+    }
+}
+// ---------------------------------------------------------------------------------------------------
+/// Uniformly random hits on a fully resident pool. After the first round most
+/// hits are LRU touches, the remaining ones are FIFO -> LRU promotions.
+void FixPage_RandomHit(benchmark::State &state) {
+    auto page_count = static_cast<uint64_t>(state.range(0));
+    BufferManager buffer_manager{PAGE_SIZE, page_count};
+    warmUp(buffer_manager, page_count);
+
+    std::mt19937_64 engine{0};
+    std::uniform_int_distribution<uint64_t> page_distr{0, page_count - 1};
+    std::vector<uint64_t> page_ids(1 << 16);
+    for (auto& page_id : page_ids) {
+        page_id = page_distr(engine);
+    }
+
+    size_t i = 0;
+    for (auto _ : state) {
+        auto& page = buffer_manager.fix_page(page_ids[i++ & (page_ids.size() - 1)], false);
+        benchmark::DoNotOptimize(page.get_data());
+        buffer_manager.unfix_page(page, false);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+// ---------------------------------------------------------------------------------------------------
+/// Repeated hits on the coldest FIFO page, which is promoted on its first hit.
+void FixPage_Promote(benchmark::State &state) {
+    auto page_count = static_cast<uint64_t>(state.range(0));
+    BufferManager buffer_manager{PAGE_SIZE, page_count};
+    warmUp(buffer_manager, page_count);
+
+    uint64_t page_id = 0;
+    for (auto _ : state) {
+        auto& page = buffer_manager.fix_page(page_id, false);
+        benchmark::DoNotOptimize(page.get_data());
+        buffer_manager.unfix_page(page, false);
+        page_id = (page_id + 1) % page_count;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+// ---------------------------------------------------------------------------------------------------
+constexpr uint64_t HOT_PAGE_COUNT = 64;
+// ---------------------------------------------------------------------------------------------------
+/// Shared by the threads of the read benchmarks, whose hot set always fits.
+BufferManager& hotBufferManager() {
+    static BufferManager buffer_manager{PAGE_SIZE, 1024};
+    static bool warm = (warmUp(buffer_manager, HOT_PAGE_COUNT), true);
+    benchmark::DoNotOptimize(warm);
+    return buffer_manager;
+}
+// ---------------------------------------------------------------------------------------------------
+/// Reads of a small hot set with shared latches, which write to the latch,
+/// the use counter and the LRU queue of every page.
+void Read_Shared(benchmark::State &state) {
+    auto& buffer_manager = hotBufferManager();
+    uint64_t page_id = 0;
+    for (auto _ : state) {
+        auto& page = buffer_manager.fix_page(page_id, false);
+        benchmark::DoNotOptimize(*reinterpret_cast<uint64_t*>(page.get_data()));
+        buffer_manager.unfix_page(page, false);
+        page_id = (page_id + 1) % HOT_PAGE_COUNT;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+// ---------------------------------------------------------------------------------------------------
+/// Reads of the same hot set with optimistic latches, which only read shared
+/// cache lines.
+void Read_Optimistic(benchmark::State &state) {
+    auto& buffer_manager = hotBufferManager();
+    uint64_t page_id = 0;
+    uint64_t restarts = 0;
+    for (auto _ : state) {
+        while (true) {
+            uint64_t version;
+            auto& page = buffer_manager.fix_page_optimistic(page_id, version);
+            benchmark::DoNotOptimize(*reinterpret_cast<uint64_t*>(page.get_data()));
+            if (BufferManager::validate_page(page, version)) {
+                break;
+            }
+            ++restarts;
+        }
+        page_id = (page_id + 1) % HOT_PAGE_COUNT;
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["restarts"] = static_cast<double>(restarts);
+}
+// ---------------------------------------------------------------------------------------------------
+constexpr uint64_t CHILD_COUNT = 8;
+// ---------------------------------------------------------------------------------------------------
+/// Creates a parent page 0 that references the pages 1..CHILD_COUNT and
+/// makes all of them resident.
+void makeParent(BufferManager& buffer_manager) {
+    auto& parent = buffer_manager.fix_page(0, true);
+    for (uint64_t i = 0; i < CHILD_COUNT; ++i) {
+        new (parent.get_data() + i * sizeof(moderndbs::Swip)) moderndbs::Swip{i + 1};
+    }
+    buffer_manager.unfix_page(parent, true);
+    warmUp(buffer_manager, CHILD_COUNT + 1);
+}
+// ---------------------------------------------------------------------------------------------------
+/// Parent to child steps that look up the child by its page id.
+void Traverse_PageId(benchmark::State &state) {
+    BufferManager buffer_manager{PAGE_SIZE, 1024};
+    makeParent(buffer_manager);
+    uint64_t child = 0;
+    for (auto _ : state) {
+        auto& parent = buffer_manager.fix_page(0, false);
+        auto* swips = reinterpret_cast<moderndbs::Swip*>(parent.get_data());
+        auto& page = buffer_manager.fix_page(swips[child].get_page_id(), false);
+        benchmark::DoNotOptimize(page.get_data());
+        buffer_manager.unfix_page(page, false);
+        buffer_manager.unfix_page(parent, false);
+        child = (child + 1) % CHILD_COUNT;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+// ---------------------------------------------------------------------------------------------------
+/// The same steps through swizzled swips.
+void Traverse_Swip(benchmark::State &state) {
+    BufferManager buffer_manager{PAGE_SIZE, 1024};
+    makeParent(buffer_manager);
+    uint64_t child = 0;
+    for (auto _ : state) {
+        auto& parent = buffer_manager.fix_page(0, false);
+        auto* swips = reinterpret_cast<moderndbs::Swip*>(parent.get_data());
+        auto& page = buffer_manager.fix_swip(parent, swips[child], false);
+        benchmark::DoNotOptimize(page.get_data());
+        buffer_manager.unfix_page(page, false);
+        buffer_manager.unfix_page(parent, false);
+        child = (child + 1) % CHILD_COUNT;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+// ---------------------------------------------------------------------------------------------------
+constexpr uint64_t SCALING_PAGE_COUNT = 4096;
+// ---------------------------------------------------------------------------------------------------
+/// Shared by the threads of the scaling benchmark, fully resident.
+BufferManager& scalingBufferManager(size_t shards) {
+    auto make = [](size_t shards) {
+        moderndbs::BufferManagerOptions options;
+        options.shards = shards;
+        auto buffer_manager = std::make_unique<BufferManager>(PAGE_SIZE, SCALING_PAGE_COUNT, options);
+        warmUp(*buffer_manager, SCALING_PAGE_COUNT);
+        return buffer_manager;
+    };
+    static auto unsharded = make(1);
+    static auto sharded = make(64);
+    return shards == 1 ? *unsharded : *sharded;
+}
+// ---------------------------------------------------------------------------------------------------
+/// Uniformly random fixes from many threads. Every hit updates the queues of
+/// its shard, so with a single shard all threads contend on the same latches.
+void FixPage_Scaling(benchmark::State &state) {
+    auto& buffer_manager = scalingBufferManager(static_cast<size_t>(state.range(0)));
+    std::mt19937_64 engine{static_cast<uint64_t>(state.thread_index())};
+    std::uniform_int_distribution<uint64_t> page_distr{0, SCALING_PAGE_COUNT - 1};
+    std::vector<uint64_t> page_ids(1 << 16);
+    for (auto& page_id : page_ids) {
+        page_id = page_distr(engine);
+    }
+
+    size_t i = 0;
+    for (auto _ : state) {
+        auto& page = buffer_manager.fix_page(page_ids[i++ & (page_ids.size() - 1)], false);
+        benchmark::DoNotOptimize(page.get_data());
+        buffer_manager.unfix_page(page, false);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+// ---------------------------------------------------------------------------------------------------
+constexpr size_t SCAN_PAGE_SIZE = 4096;
+constexpr uint64_t SCAN_PAGE_COUNT = 4096;
+constexpr uint16_t SCAN_SEGMENT = 32;
+// ---------------------------------------------------------------------------------------------------
+/// Full scans of a segment that is 16 times larger than the pool, through the
+/// pool (0) or mapped (1). The pool copies every page from the page cache and
+/// evicts all the time, the mapping does neither.
+void Scan_Cold(benchmark::State &state) {
+    uint64_t segment_shift = static_cast<uint64_t>(SCAN_SEGMENT) << 48;
+    {
+        BufferManager writer{SCAN_PAGE_SIZE, 64};
+        for (uint64_t page_id = 0; page_id < SCAN_PAGE_COUNT; ++page_id) {
+            auto& page = writer.fix_page(segment_shift | page_id, true);
+            page.get_data()[0] = static_cast<char>(page_id);
+            writer.unfix_page(page, true);
+        }
+    }
+    moderndbs::BufferManagerOptions options;
+    if (state.range(0) == 1) {
+        options.mapped_segments[SCAN_SEGMENT] = moderndbs::BufferManagerOptions::SEQUENTIAL;
+    }
+    BufferManager buffer_manager{SCAN_PAGE_SIZE, SCAN_PAGE_COUNT / 16, options};
+
+    for (auto _ : state) {
+        uint64_t sum = 0;
+        for (uint64_t page_id = 0; page_id < SCAN_PAGE_COUNT; ++page_id) {
+            auto& page = buffer_manager.fix_page(segment_shift | page_id, false);
+            sum += static_cast<uint8_t>(page.get_data()[0]);
+            buffer_manager.unfix_page(page, false);
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * SCAN_PAGE_COUNT);
+    state.SetBytesProcessed(state.iterations() * SCAN_PAGE_COUNT * SCAN_PAGE_SIZE);
+    std::remove(std::to_string(SCAN_SEGMENT).c_str());
+}
+// ---------------------------------------------------------------------------------------------------
+constexpr uint16_t TIER_SEGMENT = 34;
+// ---------------------------------------------------------------------------------------------------
+/// Random fixes of a working set three times the pool, of mostly empty pages,
+/// without (0) and with (1) a compressed tier that holds all evicted pages.
+void FixPage_CompressedTier(benchmark::State &state) {
+    constexpr uint64_t page_count = 3072;
+    uint64_t segment_shift = static_cast<uint64_t>(TIER_SEGMENT) << 48;
+    {
+        BufferManager writer{SCAN_PAGE_SIZE, 64};
+        for (uint64_t page_id = 0; page_id < page_count; ++page_id) {
+            auto& page = writer.fix_page(segment_shift | page_id, true);
+            std::memcpy(page.get_data(), &page_id, sizeof(page_id));
+            writer.unfix_page(page, true);
+        }
+    }
+    moderndbs::BufferManagerOptions options;
+    if (state.range(0) == 1) {
+        options.compressed_cache_size = page_count * 64;
+    }
+    BufferManager buffer_manager{SCAN_PAGE_SIZE, page_count / 3, options};
+
+    std::mt19937_64 engine{0};
+    std::uniform_int_distribution<uint64_t> page_distr{0, page_count - 1};
+    std::vector<uint64_t> page_ids(1 << 16);
+    for (auto& page_id : page_ids) {
+        page_id = segment_shift | page_distr(engine);
+    }
+    size_t i = 0;
+    for (auto _ : state) {
+        auto& page = buffer_manager.fix_page(page_ids[i++ & (page_ids.size() - 1)], false);
+        benchmark::DoNotOptimize(page.get_data());
+        buffer_manager.unfix_page(page, false);
+    }
+    state.SetItemsProcessed(state.iterations());
+    auto stats = buffer_manager.get_stats();
+    state.counters["compressed_hit_ratio"] = stats.misses == 0 ? 0.0 : static_cast<double>(stats.compressed_hits) / static_cast<double>(stats.misses);
+    std::remove(std::to_string(TIER_SEGMENT).c_str());
+}
+// ---------------------------------------------------------------------------------------------------
+}  // namespace
+// ---------------------------------------------------------------------------------------------------
+BENCHMARK(FixPage_RandomHit)->Arg(1000)->Arg(100000)->Arg(1000000);
+BENCHMARK(FixPage_Promote)->Arg(1000)->Arg(100000)->Arg(1000000);
+BENCHMARK(Read_Shared)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK(Read_Optimistic)->ThreadRange(1, 64)->UseRealTime();
+BENCHMARK(Traverse_PageId);
+BENCHMARK(Traverse_Swip);
+BENCHMARK(FixPage_Scaling)->Arg(1)->Arg(64)->Threads(1)->Threads(8)->Threads(32)->Threads(64)->UseRealTime();
+BENCHMARK(Scan_Cold)->Arg(0)->Arg(1);
+BENCHMARK(FixPage_CompressedTier)->Arg(0)->Arg(1);
+// ---------------------------------------------------------------------------------------------------
+BENCHMARK_MAIN();
+// ---------------------------------------------------------------------------------------------------
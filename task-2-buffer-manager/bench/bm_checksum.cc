@@ -0,0 +1,49 @@
+// ---------------------------------------------------------------------------------------------------
+// MODERNDBS
+// ---------------------------------------------------------------------------------------------------
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "moderndbs/checksum.h"
+#include "benchmark/benchmark.h"
+// ---------------------------------------------------------------------------------------------------
+namespace {
+// ---------------------------------------------------------------------------------------------------
+/// Checksums of pages of `range(1)` bytes with the software tables
+/// (`range(0)` 0) or the CPU instruction (`range(0)` 1). Besides the
+/// throughput, reports the time it takes to checksum 1 GB.
+void Crc32c(benchmark::State &state) {
+    bool hardware = state.range(0) == 1;
+    auto page_size = static_cast<size_t>(state.range(1));
+    if (hardware && !moderndbs::crc32c_hardware_available()) {
+        state.SkipWithError("no SSE4.2");
+        return;
+    }
+    // Cycle through more pages than the caches hold, like page I/O does.
+    size_t page_count = std::max<size_t>((64 << 20) / page_size, 1);
+    std::vector<char> data(page_count * page_size);
+    std::mt19937_64 engine{0};
+    for (auto& byte : data) {
+        byte = static_cast<char>(engine());
+    }
+    size_t i = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (auto _ : state) {
+        const char* page = data.data() + (i++ % page_count) * page_size;
+        uint32_t crc = hardware ? moderndbs::crc32c(page, page_size) : moderndbs::crc32c_software(page, page_size);
+        benchmark::DoNotOptimize(crc);
+    }
+    auto elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    auto bytes = static_cast<double>(state.iterations()) * static_cast<double>(page_size);
+    state.SetBytesProcessed(static_cast<int64_t>(bytes));
+    state.counters["ms_per_gb"] = elapsed / 1e6 / (bytes / 1e9);
+}
+// ---------------------------------------------------------------------------------------------------
+}  // namespace
+// ---------------------------------------------------------------------------------------------------
+BENCHMARK(Crc32c)->Args({0, 4096})->Args({1, 4096})->Args({0, 65536})->Args({1, 65536});
+// ---------------------------------------------------------------------------------------------------
+BENCHMARK_MAIN();
+// ---------------------------------------------------------------------------------------------------
@@ -0,0 +1,78 @@
+// ---------------------------------------------------------------------------------------------------
+// MODERNDBS
+// ---------------------------------------------------------------------------------------------------
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "moderndbs/buffer_manager.h"
+#include "benchmark/benchmark.h"
+// ---------------------------------------------------------------------------------------------------
+using BufferManager = moderndbs::BufferManager;
+using ReplacementPolicy = moderndbs::ReplacementPolicy;
+// ---------------------------------------------------------------------------------------------------
+namespace {
+// ---------------------------------------------------------------------------------------------------
+constexpr size_t PAGE_SIZE = 64;
+constexpr size_t POOL_SIZE = 256;
+constexpr uint64_t HOT_PAGE_COUNT = 192;
+constexpr uint64_t COLD_PAGE_COUNT = 4096;
+constexpr uint64_t SCAN_LENGTH = 512;
+constexpr uint64_t SEGMENT_SHIFT = static_cast<uint64_t>(30) << 48;
+// ---------------------------------------------------------------------------------------------------
+/// A synthetic trace: 80% of the accesses go to a hot set that fits into the
+/// pool, the rest to random cold pages, and every 16384 accesses a scan
+/// reads more cold pages than the pool holds.
+const std::vector<uint64_t>& getTrace() {
+    static std::vector<uint64_t> trace = [] {
+        std::vector<uint64_t> trace;
+        std::mt19937_64 engine{0};
+        std::uniform_int_distribution<uint64_t> hot_distr{0, HOT_PAGE_COUNT - 1};
+        std::uniform_int_distribution<uint64_t> cold_distr{HOT_PAGE_COUNT, HOT_PAGE_COUNT + COLD_PAGE_COUNT - 1};
+        std::bernoulli_distribution hot{0.8};
+        uint64_t scan_start = HOT_PAGE_COUNT;
+        while (trace.size() < (1 << 18)) {
+            if (trace.size() % (1 << 14) == 0) {
+                for (uint64_t i = 0; i < SCAN_LENGTH; ++i) {
+                    trace.push_back(scan_start + i);
+                }
+                scan_start = HOT_PAGE_COUNT + (scan_start + SCAN_LENGTH) % (COLD_PAGE_COUNT - SCAN_LENGTH);
+            }
+            trace.push_back(hot(engine) ? hot_distr(engine) : cold_distr(engine));
+        }
+        return trace;
+    }();
+    return trace;
+}
+// ---------------------------------------------------------------------------------------------------
+/// Replays the trace on a small pool with the policy `state.range(0)` and
+/// reports the hit ratio.
+void Replay_Trace(benchmark::State &state) {
+    moderndbs::BufferManagerOptions options;
+    options.io_mode = moderndbs::File::BUFFERED;
+    options.replacement_policy = static_cast<ReplacementPolicy::Kind>(state.range(0));
+    BufferManager buffer_manager{PAGE_SIZE, POOL_SIZE, options};
+    const auto& trace = getTrace();
+
+    size_t i = 0;
+    for (auto _ : state) {
+        auto& page = buffer_manager.fix_page(SEGMENT_SHIFT | trace[i], false);
+        benchmark::DoNotOptimize(page.get_data());
+        buffer_manager.unfix_page(page, false);
+        i = (i + 1) % trace.size();
+    }
+    auto stats = buffer_manager.get_stats();
+    state.SetItemsProcessed(state.iterations());
+    state.counters["hit_ratio"] = static_cast<double>(stats.hits) / static_cast<double>(stats.hits + stats.misses);
+}
+// ---------------------------------------------------------------------------------------------------
+}  // namespace
+// ---------------------------------------------------------------------------------------------------
+BENCHMARK(Replay_Trace)
+    ->ArgName("policy")
+    ->Arg(ReplacementPolicy::TWO_Q)
+    ->Arg(ReplacementPolicy::CLOCK)
+    ->Arg(ReplacementPolicy::LRU_K)
+    ->Arg(ReplacementPolicy::ARC);
+// ---------------------------------------------------------------------------------------------------
+BENCHMARK_MAIN();
+// ---------------------------------------------------------------------------------------------------
@@ -1,3 +1,12 @@
 # ---------------------------------------------------------------------------
 # MODERNDBS
 # ---------------------------------------------------------------------------
+
+add_executable(bm_buffer_manager bench/bm_buffer_manager.cc)
+target_link_libraries(bm_buffer_manager moderndbs benchmark Threads::Threads)
+
+add_executable(bm_replacement_policy bench/bm_replacement_policy.cc)
+target_link_libraries(bm_replacement_policy moderndbs benchmark Threads::Threads)
+
+add_executable(bm_checksum bench/bm_checksum.cc)
+target_link_libraries(bm_checksum moderndbs benchmark Threads::Threads)
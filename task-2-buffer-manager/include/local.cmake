@@ -8,5 +8,7 @@
 
 set(
     INCLUDE_H
-    include/moderndbs/buffer_manager.h include/moderndbs/file.h
+    include/moderndbs/async_io.h include/moderndbs/buffer_manager.h include/moderndbs/buffer_stats.h include/moderndbs/checksum.h
+    include/moderndbs/compressed_cache.h include/moderndbs/file.h include/moderndbs/log_manager.h
+    include/moderndbs/recovery.h include/moderndbs/replacement_policy.h include/moderndbs/trace_recorder.h
 )
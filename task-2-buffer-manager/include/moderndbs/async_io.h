@@ -0,0 +1,84 @@
+#ifndef INCLUDE_MODERNDBS_ASYNC_IO_H_
+#define INCLUDE_MODERNDBS_ASYNC_IO_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include "moderndbs/file.h"
+
+
+namespace moderndbs {
+
+///
+/// A block read or write on a `File` that is executed asynchronously by an
+/// `AsyncIO` engine. The request must stay alive until it completed.
+///
+struct IORequest {
+    /// Kind of the request
+    enum Kind { READ, WRITE };
+
+    Kind kind = READ;
+    File* file = nullptr;
+    /// Offset in the file and size of the block, see `File::read_block()`
+    /// and `File::write_block()`.
+    size_t offset = 0;
+    size_t size = 0;
+    char* block = nullptr;
+    /// When set, the request is vectored: it moves the memory of
+    /// `block_count` blocks from or to adjacent blocks of the file starting at
+    /// `offset`, see `File::read_blocks()`. `block` is ignored then and `size`
+    /// must be the total size of the blocks.
+    const File::Block* blocks = nullptr;
+    size_t block_count = 0;
+    /// When set, the next request of the same batch is only started after
+    /// this one completed successfully. Otherwise it fails with ECANCELED.
+    bool link_next = false;
+
+    /// Set by the engine when the request completed.
+    std::atomic<bool> done{false};
+    /// errno of a failed request, 0 on success.
+    int error = 0;
+};
+
+///
+/// Asynchronous block I/O. Requests are handed to the engine in batches and
+/// executed concurrently, so a few threads can keep many requests in flight.
+///
+class AsyncIO {
+public:
+    virtual ~AsyncIO() = default;
+
+    /// Submits a batch of requests. On io_uring the whole batch is passed to
+    /// the kernel with a single system call.
+    /// Is thread-safe w.r.t concurrent calls to `submit()` and `wait()`.
+    /// @param[in] requests Requests that should be executed. Their `done`
+    ///                     flag must be false.
+    /// @param[in] count    Number of requests.
+    virtual void submit(IORequest* const* requests, size_t count) = 0;
+
+    /// Submits a single request.
+    void submit(IORequest& request) {
+        IORequest* requests[] = {&request};
+        submit(requests, 1);
+    }
+
+    /// Blocks until `request` completed. Throws `std::system_error` when the
+    /// request failed.
+    /// Is thread-safe w.r.t concurrent calls to `submit()` and `wait()`.
+    virtual void wait(IORequest& request) = 0;
+
+    /// Creates an io_uring engine when the kernel supports it and falls back
+    /// to `make_thread_pool()` otherwise.
+    /// @param[in] queue_depth Maximum number of requests in flight.
+    static std::unique_ptr<AsyncIO> make(unsigned queue_depth);
+
+    /// Creates an engine that executes requests with blocking
+    /// `File::read_block()` and `File::write_block()` calls on a pool of
+    /// threads.
+    /// @param[in] thread_count Number of I/O threads.
+    static std::unique_ptr<AsyncIO> make_thread_pool(unsigned thread_count);
+};
+
+}  // namespace moderndbs
+
+#endif
@@ -1,34 +1,166 @@
 #ifndef INCLUDE_MODERNDBS_BUFFER_MANAGER_H
 #define INCLUDE_MODERNDBS_BUFFER_MANAGER_H
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstddef>
 #include <cstdint>
 #include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 #include <vector>
+#include "moderndbs/async_io.h"
+#include "moderndbs/buffer_stats.h"
+#include "moderndbs/compressed_cache.h"
 #include "moderndbs/file.h"
+#include "moderndbs/log_manager.h"
+#include "moderndbs/replacement_policy.h"
+#include "moderndbs/trace_recorder.h"
 #include <shared_mutex>
+#include <thread>
 
 
 namespace moderndbs {
 
+class BufferFrame;
+class TwoQPolicy;
+class ClockPolicy;
+class LruKPolicy;
+class ArcPolicy;
+
+/// Intrusive doubly-linked list of frames. The links are stored in the frames
+/// themselves, so appending, removing and taking the front are constant-time
+/// and never allocate. A frame can be in at most one list at a time.
+class FrameList {
+private:
+    BufferFrame* head = nullptr;
+    BufferFrame* tail = nullptr;
+    size_t length = 0;
+
+public:
+    /// Returns the first frame or nullptr when the list is empty.
+    BufferFrame* front() const { return head; }
+
+    /// Returns the number of frames in the list.
+    size_t size() const { return length; }
+
+    /// Appends `frame` at the end of the list.
+    void push_back(BufferFrame* frame);
+
+    /// Inserts `frame` in front of `position`, which must be in this list.
+    void insert_before(BufferFrame* position, BufferFrame* frame);
+
+    /// Unlinks `frame`, which must be in this list.
+    void remove(BufferFrame* frame);
+
+    /// Appends up to `limit` frames from the front of the list to `frames`.
+    void collect(size_t limit, std::vector<BufferFrame*>& frames) const;
+};
+
+
+/// A reference to a child page that is stored inside the data of its parent
+/// page. While the child is resident, the swip can be swizzled to point
+/// directly to the child's frame, so following it does not need the page
+/// table. The buffer manager unswizzles it again before the child is evicted
+/// and never writes a parent with swizzled children, so the page ids are what
+/// ends up on disk. The most significant bit marks swizzled swips, so page ids
+/// referenced by swips must be in segments below 2^15.
+class Swip {
+private:
+    friend class BufferManager;
+    friend class PageTable;
+
+    static constexpr uint64_t swizzledBit = 1ull << 63;
+
+    std::atomic<uint64_t> value;
+
+public:
+    /// Constructor.
+    explicit Swip(uint64_t page_id = 0) : value(page_id) {}
+
+    /// Returns whether the swip points to a resident frame.
+    bool is_swizzled() const { return (value.load() & swizzledBit) != 0; }
+
+    /// Returns the page id of the referenced page.
+    uint64_t get_page_id() const;
+};
+static_assert(sizeof(Swip) == sizeof(uint64_t), "swips are stored in place of page ids");
+
+
 class BufferFrame {
 private:
     friend class BufferManager;
+    friend class PageTable;
+    friend class FrameList;
+    friend class TwoQPolicy;
+    friend class ClockPolicy;
+    friend class LruKPolicy;
+    friend class ArcPolicy;
 
-    std::vector<uint64_t> data;
-    int useCounter;
+    /// Points into the page arena of the buffer manager.
+    char* data = nullptr;
+    /// Number of threads that fixed (or are about to fix) this frame. Only
+    /// incremented while holding the latch of the page table partition, or
+    /// through a swizzled swip that is checked again afterwards.
+    std::atomic<int> useCounter{0};
+    /// Links of the free list or the list of the replacement policy the
+    /// frame is in.
+    BufferFrame* prev = nullptr;
+    BufferFrame* next = nullptr;
+    /// State of the replacement policy: which of its lists the frame is in,
+    /// the position in its heap and the logical times of the last two
+    /// accesses. Only changed while holding the queue latches.
+    uint8_t policyList = 0;
+    size_t policyIndex = 0;
+    uint64_t policyHistory[2] = {0, 0};
+    /// Whether the page was read ahead and not fixed since. Its first fix
+    /// is not passed to the replacement policy, so scans cannot promote
+    /// their pages.
+    bool prefetched = false;
+    /// Next frame in the same page table bucket. Atomic, since optimistic
+    /// lookups walk the bucket chains without latching them.
+    std::atomic<BufferFrame*> hashNext{nullptr};
+    /// Odd while the frame is latched exclusively, incremented again when the
+    /// exclusive latch is released. Optimistic readers validate against it.
+    std::atomic<uint64_t> version{0};
+    /// Set by accesses that do not touch the queues: optimistic reads, fixes
+    /// through swizzled swips and all fixes with `ReplacementPolicy::CLOCK`.
+    /// The replacement policy treats the frame as accessed when it considers
+    /// it for eviction.
+    std::atomic<bool> referenced{false};
+    /// The parent frame and the swip in its data that point to this frame,
+    /// nullptr when the frame is not swizzled. Only changed while holding the
+    /// latch of the page table partition.
+    BufferFrame* swizzledParent = nullptr;
+    Swip* swizzledSwip = nullptr;
+    /// Number of swizzled swips in the data of this frame. Frames with
+    /// swizzled children are neither evicted nor written.
+    std::atomic<int> swizzledChildren{0};
+    /// Held while swips in this frame are swizzled and while the frame is
+    /// written, so no pointers end up on disk.
+    std::mutex swizzleMutex;
+    /// Whether the frame points into a mapped segment, see
+    /// `BufferManagerOptions::mapped_segments`. Such frames are not part of
+    /// the pool and never latched.
+    bool mapped = false;
+    /// The NUMA node whose memory holds the page data, see
+    /// `BufferManagerOptions::numa`.
+    uint16_t node = 0;
 
 public:
-    bool dirty;
-    bool exclusive;
-    uint64_t pageid;
+    std::atomic<bool> dirty{false};
+    /// Whether the frame is latched exclusively. Only written by the exclusive
+    /// latch holder.
+    bool exclusive = false;
+    std::atomic<uint64_t> pageid{0};
     mutable std::shared_mutex mutex_;
 
     /// Returns a pointer to this page's data.
     char* get_data();
-    explicit BufferFrame(size_t pageSize);
-
-    ~BufferFrame() = default;
 };
 
 
@@ -41,32 +173,494 @@ public:
 };
 
 
+class checksum_error
+: public std::exception {
+public:
+    const char* what() const noexcept override {
+        return "page checksum mismatch";
+    }
+};
+
+
+/// Concurrent mapping from page ids to resident frames. The buckets are
+/// allocated once and chained through the frames, so inserting and erasing
+/// never allocate. Buckets are grouped into partitions that are latched
+/// independently, so lookups of different pages rarely contend.
+class PageTable {
+private:
+    static constexpr size_t partitionCount = 64;
+
+    std::array<std::mutex, partitionCount> partitions;
+    std::unique_ptr<std::atomic<BufferFrame*>[]> buckets;
+    unsigned bucketShift;
+
+    size_t getBucket(uint64_t page_id) const;
+
+    /// Unlinks `frame` from the chain of `bucket`, whose partition must be
+    /// latched.
+    void unlink(size_t bucket, BufferFrame* frame);
+
+    /// Restores the page id in the swip that points to `frame`. The partition
+    /// of the frame must be latched.
+    static void clearSwip(BufferFrame* frame);
+
+public:
+    /// Constructor.
+    /// @param[in] capacity Maximum number of frames in the table.
+    explicit PageTable(size_t capacity);
+
+    /// Looks up the frame for `page_id` and increments its use counter while
+    /// the partition is latched, so the frame cannot be evicted in between.
+    /// Returns nullptr when the page is not resident.
+    BufferFrame* fixFrame(uint64_t page_id);
+
+    /// Looks up the frame for `page_id` without latching or pinning it. The
+    /// result may be stale or miss a page that is concurrently inserted, so
+    /// it must be validated through the frame's version.
+    BufferFrame* findOptimistic(uint64_t page_id) const;
+
+    /// Inserts a frame for its page id. The page must not be resident.
+    void insert(BufferFrame* frame);
+
+    /// Removes `frame` from the table when it is not in use and has no
+    /// swizzled children. A swip that points to the frame is unswizzled.
+    /// Returns false when another thread fixed the frame in the meantime.
+    bool eraseUnused(BufferFrame* frame);
+
+    /// Removes `frame` from the table regardless of its use counter. Only
+    /// for frames whose page was never loaded, which cannot be swizzled.
+    void erase(BufferFrame* frame);
+
+    /// Swizzles `swip` in the data of `parent` to point to `frame`, which
+    /// must be fixed. Does nothing when the frame is already swizzled or the
+    /// parent is currently written.
+    void swizzle(BufferFrame* frame, BufferFrame* parent, Swip& swip);
+
+    /// Turns `swip` back into its page id when it points to `frame`. The
+    /// frame must be fixed.
+    void unswizzle(BufferFrame* frame, Swip& swip);
+
+    /// Turns the swip that points to `frame` back into its page id when it
+    /// lies in `parent`. The frame need not be fixed, but the `swizzleMutex`
+    /// of the parent must be held.
+    void unswizzleChild(BufferFrame* frame, BufferFrame* parent);
+};
+
+
+/// Optional settings of a `BufferManager`.
+struct BufferManagerOptions {
+    /// Expected access pattern of a mapped segment, passed to `madvise()`.
+    enum Access {
+        NORMAL,
+        SEQUENTIAL,
+        RANDOM
+    };
+
+    /// Back the page arena with huge pages when the system provides them.
+    bool huge_pages = false;
+    /// `IOMode` of the segment files. With `File::DIRECT` the page size must
+    /// be a multiple of `File::DIRECT_ALIGNMENT`. With `File::BUFFERED` and
+    /// `File::DIRECT` pages are only durable after the segment files were
+    /// synced, which the destructor does.
+    File::IOMode io_mode = File::SYNC;
+    /// Start a background thread that writes back dirty, unfixed frames at
+    /// the cold end of the FIFO and LRU queues before they are evicted, so
+    /// that misses rarely have to write a victim themselves.
+    bool background_writer = false;
+    /// Fraction of all frames, counted from the cold end of the FIFO queue
+    /// and then the LRU queue, that the background writer keeps clean.
+    double clean_fraction = 0.25;
+    /// Maximum number of pages the background writer submits as one batch.
+    size_t write_batch_size = 32;
+    /// Time between two rounds of the background writer. It is woken up
+    /// earlier whenever `fix_page()` has to write back a dirty victim.
+    std::chrono::milliseconds writer_interval{10};
+    /// How long `fix_page()` waits for a frame to be unfixed when all frames
+    /// are in use, before it throws `buffer_full_error`. Zero throws right
+    /// away.
+    std::chrono::microseconds buffer_full_timeout{0};
+    /// Number of pages `fix_page()` reads ahead when it detects a sequential
+    /// scan of a segment, zero disables read-ahead. The pages are read in
+    /// one batch with the missing page, see `BufferManager::prefetch()`.
+    size_t read_ahead = 0;
+    /// Number of independent shards the pool is split into. Consecutive pages
+    /// of a segment are striped over the shards, and every shard has its own
+    /// frames, page table, replacement policy and queue latches, so fixes on
+    /// different shards never contend.
+    /// The frames are split evenly, so a shard can run full while others
+    /// still have free frames. At most one shard per frame is used.
+    size_t shards = 1;
+    /// The replacement policy of every shard, see `ReplacementPolicy`.
+    ReplacementPolicy::Kind replacement_policy = ReplacementPolicy::TWO_Q;
+    /// Record every fix and unfix into this file, see `TraceRecorder`. Empty
+    /// disables tracing.
+    std::string trace_file;
+    /// The write-ahead log of the pages. Before a page is written, the log is
+    /// flushed up to the LSN in its first 8 bytes, see `LogManager`. Must
+    /// outlive the buffer manager. Null disables the check.
+    LogManager* wal = nullptr;
+    /// Segments that are mapped read-only instead of being read into the
+    /// pool, with their access pattern. `fix_page()` returns frames that
+    /// point directly into the mapping, so their pages are neither copied nor
+    /// limited by the pool size. They can only be fixed shared, are never
+    /// swizzled and must not change while the buffer manager exists. The
+    /// segment files must exist, pages past their end cannot be fixed.
+    std::unordered_map<uint16_t, Access> mapped_segments;
+    /// Memory budget in bytes of a second cache tier that keeps clean pages
+    /// evicted from the pool in compressed form, see `CompressedCache`. A
+    /// miss on such a page decompresses it instead of reading it. Zero
+    /// disables the tier.
+    size_t compressed_cache_size = 0;
+    /// Partition the frames by NUMA node. The arena is split into one slice
+    /// per node, whose memory is bound to that node, and every shard gets
+    /// frames of every node. A miss loads the page into a frame of the node
+    /// of the fixing thread when one is free or among the coldest frames,
+    /// and the statistics count local and remote fixes. Needs libnuma at
+    /// build time, without it or on a single node all frames are on node 0.
+    bool numa = false;
+    /// Stamp a CRC32C checksum into the header of every page that is written
+    /// and verify it whenever a page is read, see `crc32c()`. A fix whose
+    /// read finds a mismatch throws `checksum_error`. The checksum occupies
+    /// `BufferManager::page_checksum_size` bytes at
+    /// `BufferManager::page_checksum_offset`, right after the page LSN,
+    /// within the first `LogManager::page_header_size` bytes that pages must
+    /// leave unused. Pages that are all zero, like holes in a
+    /// segment file, are valid. Pages of mapped segments are not verified.
+    bool page_checksums = false;
+};
+
+
 class BufferManager {
 private:
-    std::vector<BufferFrame*> fifoQueue;
-    std:: vector<BufferFrame*> lruQueue;
-    int maxPage;
+    BufferManagerOptions options;
     size_t pageSize;
-    mutable std::mutex lruMutex;
-    mutable std::mutex fifoMutex;
-    mutable std::mutex fileUseMutex;
+    /// All frames and their page data are allocated once in the constructor.
+    /// Unused frames are kept in `freeFrames`, evicted frames are reused.
+    std::unique_ptr<BufferFrame[]> frames;
+    size_t frameCount;
+    char* arena;
+    size_t arenaSize;
+
+    /// An independent part of the pool, see `BufferManagerOptions::shards`.
+    /// A frame stays in the shard it was assigned to and only holds pages
+    /// that hash to that shard. Resident pages are managed by the replacement
+    /// policy, whose state is protected by the two queue latches.
+    struct alignas(64) Shard {
+        PageTable pageTable;
+        /// One list per NUMA node.
+        std::vector<FrameList> freeFrames;
+        std::unique_ptr<ReplacementPolicy> policy;
+        std::mutex lruMutex;
+        std::mutex fifoMutex;
+
+        /// Constructor.
+        Shard(size_t capacity, ReplacementPolicy::Kind kind, size_t node_count)
+            : pageTable(capacity), freeFrames(node_count), policy(ReplacementPolicy::make(kind, capacity)) {}
+
+        /// Returns the number of free frames on all nodes.
+        size_t getFreeFrameCount() const;
+    };
+    std::vector<std::unique_ptr<Shard>> shards;
+
+    /// Number of NUMA nodes the frames are partitioned by, 1 without
+    /// `BufferManagerOptions::numa`.
+    size_t numaNodeCount = 1;
+    /// The NUMA node of every CPU, filled in NUMA mode only.
+    std::vector<uint16_t> cpuNodes;
+
+    /// Returns the NUMA node the calling thread currently runs on.
+    uint16_t getCurrentNode() const;
+
+    /// Counts a fix of `frame` as local or remote in NUMA mode.
+    void recordNumaFix(const BufferFrame* frame);
+
+    /// Removes and returns a free frame of `shard`, preferably one on
+    /// `node`. Returns nullptr when the shard has none. Must be called while
+    /// holding the queue latches of `shard`.
+    BufferFrame* takeFreeFrame(Shard& shard, uint16_t node);
+
+    /// Passes a fix of a frame that was found in the page table of `shard` to
+    /// its replacement policy. Must be called while holding the queue latches
+    /// of the shard, unless the policy allows latch-free accesses.
+    void touchFrame(Shard& shard, BufferFrame* frame);
+
+    /// Picks an unused frame with the replacement policy of `shard`, removes
+    /// it from the policy and the page table and returns it. Returns nullptr
+    /// when every frame is in use. With `clean_only` dirty frames are skipped
+    /// as well. Must be called while holding the queue latches of `shard`.
+    /// In NUMA mode the coldest frames on `node` are preferred.
+    BufferFrame* evictFrame(Shard& shard, bool clean_only = false, uint16_t node = 0);
+
+    /// Page id of frames that were given up, so fixes that waited for them
+    /// notice that they hold no page.
+    static constexpr uint64_t invalidPageId = ~uint64_t{0};
+
+    /// Gives up a frame of `shard` whose page could not be loaded: removes it
+    /// from the page table and the policy, unlatches it and returns it to the
+    /// free list. The frame must be latched exclusively and pinned once by
+    /// the caller. Latches the queues itself.
+    void releaseFrame(Shard& shard, BufferFrame* frame);
+
+    /// Puts the evicted page `page_id` back into `frame` when its write-back
+    /// failed, so its changes are not lost: the frame takes the page id
+    /// again, stays dirty and is unlatched. The same preconditions as for
+    /// `releaseFrame()` apply, and `page_id` must still be in
+    /// `writingPages`, so no other frame loaded it meanwhile.
+    void restoreVictim(Shard& shard, BufferFrame* frame, uint64_t page_id);
+
+    /// Returns the shard of a page. Consecutive pages are striped over the
+    /// shards, so a range of pages fills all shards evenly, which hashing
+    /// would not.
+    Shard& getShard(uint64_t page_id) {
+        return *shards[(get_segment_page_id(page_id) + get_segment_id(page_id)) % shards.size()];
+    }
+
+    /// An open segment file. `read_block()` and `write_block()` are
+    /// thread-safe, so page I/O on a segment never takes a latch.
+    struct SegmentFile {
+        std::unique_ptr<File> file;
+        /// Size of the file including all pages written since it was opened.
+        std::atomic<size_t> size;
+        /// The page whose miss continues a sequential scan of the segment.
+        std::atomic<uint64_t> sequentialMiss{~0ull};
+    };
+
+    /// A segment of `BufferManagerOptions::mapped_segments`. The frames of
+    /// its pages are created on first use and live as long as the mapping.
+    struct MappedSegment {
+        char* data = nullptr;
+        size_t size = 0;
+        size_t pageCount = 0;
+        std::unique_ptr<std::atomic<BufferFrame*>[]> frames;
+
+        /// Destructor. Deletes the frames and unmaps the file.
+        ~MappedSegment();
+    };
+
+    /// Mapped in the constructor and never changed, so lookups need no
+    /// latch.
+    std::unordered_map<uint16_t, std::unique_ptr<MappedSegment>> mappedSegments;
+
+    /// Returns the frame of a page of a mapped segment, nullptr when the
+    /// segment is not mapped.
+    BufferFrame* fixMapped(uint64_t page_id, bool exclusive);
+
+    /// Segment files are opened on first use and closed in the destructor.
+    std::unordered_map<uint16_t, std::unique_ptr<SegmentFile>> segmentFiles;
+    mutable std::shared_mutex segmentFilesMutex;
+
+    /// Returns the open file of a segment, opens it when necessary.
+    SegmentFile& getSegmentFile(uint16_t segment_id);
+
+    /// Maximum number of page reads and writes in flight.
+    static constexpr unsigned ioQueueDepth = 128;
+    std::unique_ptr<AsyncIO> io;
+
+    /// Maximum number of adjacent pages that are moved with one request.
+    static constexpr size_t maxExtentPages = 64;
+
+    /// An asynchronous read or write of a page, or of an extent of adjacent
+    /// pages of the same segment with one vectored request.
+    struct PageIO {
+        IORequest request;
+        SegmentFile* segmentFile = nullptr;
+        /// Size of the segment file when the request was prepared.
+        size_t fileSize = 0;
+        /// When the request was prepared, for the latency statistics.
+        std::chrono::steady_clock::time_point start;
+        /// The memory of all pages of an extent, empty for a single page.
+        std::vector<File::Block> blocks;
+    };
+
+    /// Prepares a page for its write: flushes the write-ahead log up to its
+    /// LSN and stamps its checksum.
+    void stampPage(char* data);
+
+    /// Throws `checksum_error` when the checksum of a read page does not
+    /// match.
+    void verifyPage(const char* data);
+
+    /// Prepares `pageIO` to read page `page_id` into or write it from `data`.
+    void preparePageIO(PageIO& pageIO, IORequest::Kind kind, uint64_t page_id, char* data);
+
+    /// Extends a prepared `PageIO` by the page `page_id` when it directly
+    /// follows the last page of the request. Returns false otherwise, or when
+    /// the request already spans `maxExtentPages`.
+    bool appendPage(PageIO& pageIO, uint64_t page_id, char* data);
+
+    /// Prepares the fewest requests that read or write `frames`, which must
+    /// be sorted by page id, by merging adjacent pages into extents.
+    /// `pageIOs` must hold at least one `PageIO` per frame. Returns the
+    /// number of requests.
+    size_t prepareExtents(std::vector<PageIO>& pageIOs, IORequest::Kind kind, const std::vector<BufferFrame*>& frames);
+
+    /// Returns the number of pages a `PageIO` moves.
+    size_t getPageCount(const PageIO& pageIO) const { return pageIO.request.size / pageSize; }
+
+    /// Waits for a submitted `PageIO`. Zeroes the parts of read pages that
+    /// lie past the end of their segment file. With
+    /// `BufferManagerOptions::page_checksums`, throws `checksum_error` when a
+    /// read page is corrupt.
+    void finishPageIO(PageIO& pageIO);
+
+    /// Takes frames for the pages in [page_id, page_id + count) that are not
+    /// resident and inserts them into the policy of their shard, latched
+    /// exclusively and pinned. Only uses free frames and clean victims and
+    /// stops at the end of the segment file. Latches the queues of each
+    /// shard itself, so no queues must be latched by the caller.
+    void claimPrefetchFrames(uint64_t page_id, size_t count, std::vector<BufferFrame*>& frames);
+
+    /// Waits for the reads of frames claimed by `claimPrefetchFrames()`, as
+    /// prepared by `prepareExtents()`, and unlatches them. Returns the first
+    /// error, frames whose read failed are given up with `releaseFrame()`.
+    std::exception_ptr finishPrefetch(std::vector<PageIO>& reads, const std::vector<BufferFrame*>& frames);
+
+    /// Read-ahead reads of a miss, which returns before they complete. The
+    /// frames stay latched until the batch is finished.
+    struct PrefetchBatch {
+        std::vector<PageIO> reads;
+        std::vector<BufferFrame*> frames;
+    };
+
+    /// Submitted read-ahead batches that were not finished yet. A miss holds
+    /// `prefetchBatchesMutex` from claiming the frames of its read-ahead
+    /// until the batch is added, and `prefetchBatchCount` counts the batches
+    /// from before the frames are claimed until they are finished. So a fix
+    /// that finds such a frame latched sees the count and finishes the batch
+    /// itself instead of waiting for a latch nobody releases.
+    std::vector<std::unique_ptr<PrefetchBatch>> prefetchBatches;
+    std::mutex prefetchBatchesMutex;
+    std::atomic<size_t> prefetchBatchCount{0};
+
+    /// Waits for all batches in `prefetchBatches` and finishes them with
+    /// `finishPrefetch()`. No queue latches must be held.
+    void finishPrefetchBatches();
+
+    /// Pages that were evicted while dirty and are still being written. A
+    /// miss on such a page waits until the write completed, otherwise it
+    /// could read the old version from disk.
+    std::vector<uint64_t> writingPages;
+    std::mutex writingPagesMutex;
+    std::condition_variable writingPagesDone;
+
+    mutable StatsCounters stats;
+
+    /// Set when `BufferManagerOptions::compressed_cache_size` is not zero.
+    std::unique_ptr<CompressedCache> compressedCache;
+
+    /// Set when `BufferManagerOptions::trace_file` is given.
+    std::unique_ptr<TraceRecorder> traceRecorder;
+
+    /// Records a fix in the trace, if any.
+    void traceFix(uint64_t page_id, TraceRecord::Mode mode) {
+        if(traceRecorder){
+            traceRecorder->record(TraceRecord::FIX, page_id, mode);
+        }
+    }
+
+    /// Threads in `fix_page()` that wait for a frame to be unpinned, and the
+    /// number of frames released while there were any.
+    std::atomic<unsigned> frameWaiters{0};
+    uint64_t frameReleases = 0;
+    std::mutex frameReleasedMutex;
+    std::condition_variable frameReleased;
+
+    /// Latches a frame shared or exclusively and records the time waited for
+    /// it.
+    void lockFrame(BufferFrame *frame, bool exclusive);
+
+    /// Unlatches a frame and drops the pin of its fix, see `unpinFrame()`.
+    void unlockFrame(BufferFrame *frame, bool exclusive);
+
+    /// Latches a frame without waiting, returns false when it is latched
+    /// incompatibly.
+    bool tryLockFrame(BufferFrame* frame, bool exclusive);
+
+    /// Drops a pin of `frame` and wakes up the fixes that wait for a frame
+    /// when it was the last one.
+    void unpinFrame(BufferFrame* frame);
+
+    /// Wakes up the fixes that wait for a frame.
+    void notifyFrameReleased();
+
+    /// `fix_page()` without waiting, returns nullptr when all frames are in
+    /// use.
+    BufferFrame* tryFixPage(uint64_t page_id, bool exclusive);
+
+    /// Counts a latch acquisition that had to wait since `start`.
+    void recordLatchWait(std::chrono::steady_clock::time_point start);
+
+    /// Latches the FIFO and LRU queues of a shard and records the time waited
+    /// for them.
+    void lockQueues(Shard& shard);
+    void unlockQueues(Shard& shard);
+
+    std::thread backgroundWriter;
+    std::mutex backgroundWriterMutex;
+    std::condition_variable backgroundWriterWakeup;
+    bool stopBackgroundWriter = false;
+
+    /// Main loop of the background writer thread.
+    void runBackgroundWriter();
+
+    /// Writes back the dirty, unfixed frames among the coldest
+    /// `clean_fraction` of all frames in batches of `write_batch_size`.
+    void cleanColdFrames();
+
+    /// Restores the page ids of all swips in `parent`, whose `swizzleMutex`
+    /// must be held, so it can be written.
+    void unswizzleChildren(BufferFrame* parent);
+
+    /// Latches a frame for a write that is latched shared already. Returns
+    /// false when it is clean, or without `wait` when it has swizzled
+    /// children or another thread writes it.
+    bool lockForWrite(BufferFrame* frame, bool wait);
+
+    /// Writes the frames latched by `lockForWrite()` with as few requests as
+    /// possible, then unlatches and unpins them. Failed pages stay dirty,
+    /// the first error is kept in `error`. Returns the pages written.
+    size_t writeLatched(std::vector<PageIO>& writes, const std::vector<BufferFrame*>& latched, StatsCounters::Counter counter, std::exception_ptr& error);
+
+    /// Writes the dirty ones among the pinned `frames`, which must be sorted
+    /// by page id, in batches of `write_batch_size` and unpins all of them.
+    /// Frames that are latched exclusively are skipped or, with `wait`,
+    /// written one by one after all others, so no latch is held while
+    /// waiting. Returns the pages written.
+    size_t writeFrames(const std::vector<BufferFrame*>& frames, bool wait, StatsCounters::Counter counter, std::exception_ptr& error);
+
+    /// Writes all dirty pages of one segment, or of all segments when
+    /// `segment_id` is negative, see `flush_all()` and `checkpoint()`.
+    /// Returns the pages written.
+    size_t flushPages(int32_t segment_id, bool wait);
 
 public:
-    int pageCounter ;
+    /// Position and size in bytes of the page checksum, see
+    /// `BufferManagerOptions::page_checksums`. The page LSN comes first.
+    static constexpr size_t page_checksum_offset = sizeof(uint64_t);
+    static constexpr size_t page_checksum_size = sizeof(uint32_t);
+    static_assert(page_checksum_offset + page_checksum_size <= LogManager::page_header_size,
+        "logged updates must not overlap the page checksum");
+
     /// Constructor.
     /// @param[in] page_size  Size in bytes that all pages will have.
     /// @param[in] page_count Maximum number of pages that should reside in
     //                        memory at the same time.
-    BufferManager(size_t page_size, size_t page_count);
+    /// @param[in] options    Optional settings, see `BufferManagerOptions`.
+    BufferManager(size_t page_size, size_t page_count, const BufferManagerOptions& options = {});
+
+    BufferManager(const BufferManager&) = delete;
+    BufferManager& operator=(const BufferManager&) = delete;
 
-    /// Destructor. Writes all dirty pages to disk.
+    /// Destructor. Writes all dirty pages to disk and syncs the segment files
+    /// unless they were opened with `File::SYNC`.
     ~BufferManager();
 
     /// Returns a reference to a `BufferFrame` object for a given page id. When
     /// the page is not loaded into memory, it is read from disk. Otherwise the
     /// loaded page is used.
-    /// When the page cannot be loaded because the buffer is full, throws the
-    /// exception `buffer_full_error`.
+    /// When the page cannot be loaded because the buffer is full, waits up to
+    /// `BufferManagerOptions::buffer_full_timeout` for another thread to
+    /// unfix a page and then throws the exception `buffer_full_error`.
     /// Is thread-safe w.r.t. other concurrent calls to `fix_page()` and
     /// `unfix_page()`.
     /// @param[in] page_id   Page id of the page that should be loaded.
@@ -75,18 +669,124 @@ public:
     ///                      non-exclusively (shared).
     BufferFrame & fix_page(uint64_t page_id, bool exclusive);
 
+    /// Returns a `BufferFrame` for an optimistic read without latching or
+    /// pinning it, so concurrent readers do not write to shared cache lines.
+    /// Loads the page with a shared `fix_page()` first when it is not
+    /// resident and waits while the page is latched exclusively.
+    /// The page may be modified or even evicted while it is read: after
+    /// reading, the caller must call `validate_page()` and restart the read
+    /// when it fails. Pointers read from the page must not be followed before
+    /// validation. Optimistic reads do not move the page in the queues, they
+    /// only protect it from the next eviction attempt.
+    /// Is thread-safe w.r.t. other concurrent calls to `fix_page()`,
+    /// `fix_page_optimistic()` and `unfix_page()`.
+    /// @param[in]  page_id Page id of the page that should be read.
+    /// @param[out] version Version of the page to validate against.
+    BufferFrame& fix_page_optimistic(uint64_t page_id, uint64_t& version);
+
+    /// Returns true when `page` still holds the same version of the same page
+    /// as when `fix_page_optimistic()` returned `version`, i.e. everything
+    /// read from it in between is consistent.
+    static bool validate_page(const BufferFrame& page, uint64_t version);
+
+    /// Fixes the child page that `swip` references like `fix_page()`. When
+    /// the swip is swizzled, the frame is used directly without going through
+    /// the page table. Otherwise the page is fixed by its id and the swip is
+    /// swizzled for the next traversal.
+    /// Is thread-safe w.r.t. other concurrent calls to `fix_page()`,
+    /// `fix_swip()` and `unfix_page()`.
+    /// @param[in] parent    The page that contains `swip`. Must be fixed by
+    ///                      the caller, shared or exclusively, until the
+    ///                      child was fixed.
+    /// @param[in] swip      Reference to the child page in the data of
+    ///                      `parent`. A page must be referenced by at most
+    ///                      one swip.
+    /// @param[in] exclusive Whether the child page is locked exclusively.
+    BufferFrame& fix_swip(BufferFrame& parent, Swip& swip, bool exclusive);
+
+    /// Turns `swip` back into a page id. Must be called before a swip is
+    /// moved to another position or page, or overwritten, since evictions
+    /// write the page id back to where the swip was swizzled.
+    /// `parent` must be fixed exclusively by the caller.
+    void unswizzle(BufferFrame& parent, Swip& swip);
+
+    /// Reads the pages [page_id, page_id + count) of one segment that are not
+    /// resident yet with a single batch of requests, so a following scan
+    /// hits them. The first fix of a prefetched page is not passed to the
+    /// replacement policy, so with 2Q a scan cannot flush the hot pages.
+    /// Does not read past the end of the segment file, and stops early
+    /// instead of evicting dirty or fixed pages. Returns the number of
+    /// pages that were read. For a mapped segment, the kernel is asked to
+    /// read the pages into its cache instead.
+    /// Is thread-safe w.r.t. other concurrent calls to `fix_page()` and
+    /// `unfix_page()`.
+    size_t prefetch(uint64_t page_id, size_t count);
+
     /// Takes a `BufferFrame` reference that was returned by an earlier call to
     /// `fix_page()` and unfixes it. When `is_dirty` is / true, the page is
     /// written back to disk eventually.
     void unfix_page(BufferFrame& page, bool is_dirty);
 
+    /// Returns the number of dirty pages that `fix_page()` wrote back itself
+    /// because they were chosen as eviction victims.
+    uint64_t get_foreground_writes() const { return stats.get(StatsCounters::FOREGROUND_WRITES); }
+
+    /// Returns the number of dirty pages written by the background writer.
+    uint64_t get_background_writes() const { return stats.get(StatsCounters::BACKGROUND_WRITES); }
+
+    /// Returns a snapshot of the statistics since construction or the last
+    /// `reset_stats()`. Is thread-safe, concurrent updates may or may not
+    /// be included.
+    BufferManagerStats get_stats() const { return stats.collect(); }
+
+    /// Returns the number of NUMA nodes the frames are partitioned by, 1
+    /// without `BufferManagerOptions::numa`.
+    size_t get_numa_node_count() const { return numaNodeCount; }
+
+    /// Sets all statistics to zero.
+    void reset_stats() { stats.reset(); }
+
+    /// Writes `get_stats()` to `out`, see `BufferManagerStats::dump()`.
+    void dump_stats(std::ostream& out) const { get_stats().dump(out); }
+
+    /// Runs one round of the background writer in the calling thread.
+    /// Is thread-safe.
+    void clean_frames() { cleanColdFrames(); }
+
+    /// Writes all pages that are dirty when it is called in page id order and
+    /// syncs the segment files. Afterwards every change that was unfixed
+    /// before the call is durable. Only the pages of the current batch of
+    /// `write_batch_size` pages are latched, shared, so concurrent fixes only
+    /// wait for the pages being written. Waits for pages that are fixed
+    /// exclusively, which must not be fixed exclusively by the calling
+    /// thread. Swips in written pages are unswizzled. Throws the first error
+    /// of a write, failed pages stay dirty.
+    /// Is thread-safe.
+    void flush_all() { flushPages(-1, true); }
+
+    /// Like `flush_all()` for the pages of one segment, only that segment's
+    /// file is synced.
+    void flush_segment(uint16_t segment_id) { flushPages(segment_id, true); }
+
+    /// A fuzzy checkpoint: writes the pages that are dirty when it is called
+    /// like `flush_all()`, but never waits for a fix. Pages that are fixed
+    /// exclusively, being written by another thread or that have swizzled
+    /// children are skipped and stay dirty. Returns the number of pages
+    /// written.
+    /// Is thread-safe.
+    size_t checkpoint() { return flushPages(-1, false); }
+
     /// Returns the page ids of all pages (fixed and unfixed) that are in the
-    /// FIFO list in FIFO order.
+    /// FIFO list in FIFO order, or that the replacement policy considers
+    /// accessed once, see `ReplacementPolicy::get_pages()`. With several
+    /// shards the lists of all shards are concatenated.
     /// Is not thread-safe.
     std::vector<uint64_t> get_fifo_list() const;
 
     /// Returns the page ids of all pages (fixed and unfixed) that are in the
-    /// LRU list in LRU order.
+    /// LRU list in LRU order, or that the replacement policy considers
+    /// accessed repeatedly. With several shards the lists of all shards are
+    /// concatenated.
     /// Is not thread-safe.
     std::vector<uint64_t> get_lru_list() const;
 
@@ -101,19 +801,7 @@ public:
     static constexpr uint64_t get_segment_page_id(uint64_t page_id) {
         return page_id & ((1ull << 48) - 1);
     }
-    //BufferFrame createFrame(uint64_t pageId, bool exclusive);
-
-    void saveFrame(BufferFrame& frame);
-
-    void createFrame(BufferFrame &frame);
-
-    void lockFrame(BufferFrame *frame, bool exclusive);
-
-    void unlockFrame(BufferFrame *frame, bool exclusive);
-
-    bool pageInLruQueue(BufferFrame **frame, uint64_t pageid, bool exclusive);
 
-    bool pageInFifoQueue(BufferFrame **frame, uint64_t page_id, bool exclusive);
 };
 
 
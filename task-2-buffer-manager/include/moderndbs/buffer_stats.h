@@ -0,0 +1,165 @@
+#ifndef INCLUDE_MODERNDBS_BUFFER_STATS_H_
+#define INCLUDE_MODERNDBS_BUFFER_STATS_H_
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+
+
+namespace moderndbs {
+
+///
+/// Histogram of latencies with power-of-two buckets. Bucket `i` counts the
+/// latencies in [2^i, 2^(i+1)) nanoseconds, bucket 0 also counts zero.
+///
+struct LatencyHistogram {
+    static constexpr size_t bucket_count = 40;
+
+    std::array<uint64_t, bucket_count> buckets{};
+
+    /// Returns the bucket of a latency.
+    static size_t get_bucket(std::chrono::nanoseconds latency);
+
+    /// Returns the number of recorded latencies.
+    uint64_t count() const;
+
+    /// Returns an upper bound of the `fraction` percentile in nanoseconds,
+    /// e.g. 0.99 for the 99th percentile. Returns 0 when the histogram is
+    /// empty.
+    uint64_t percentile(double fraction) const;
+};
+
+
+///
+/// A snapshot of the statistics of a `BufferManager`, see
+/// `BufferManager::get_stats()`.
+///
+struct BufferManagerStats {
+    /// Fixes of resident pages, including swizzled and optimistic ones.
+    uint64_t hits = 0;
+    /// Fixes of pages that were not resident.
+    uint64_t misses = 0;
+    /// Misses that were served by the compressed tier instead of a read, see
+    /// `BufferManagerOptions::compressed_cache_size`.
+    uint64_t compressed_hits = 0;
+    /// Evicted clean pages that were stored in the compressed tier.
+    uint64_t compressed_stores = 0;
+    /// Fixes that moved a page from the FIFO to the LRU queue, or generally
+    /// to the pages the replacement policy considers accessed repeatedly.
+    uint64_t promotions = 0;
+    /// Frames that were taken from another page.
+    uint64_t evictions = 0;
+    /// Pages that were read ahead by `BufferManager::prefetch()` or the
+    /// sequential read-ahead of `fix_page()`.
+    uint64_t prefetches = 0;
+    /// Dirty pages that were written by `fix_page()` itself.
+    uint64_t foreground_writes = 0;
+    /// Dirty pages that were written by the background writer.
+    uint64_t background_writes = 0;
+    /// Dirty pages that were written by `BufferManager::flush_all()`,
+    /// `flush_segment()` and `checkpoint()`.
+    uint64_t flush_writes = 0;
+    /// Fixes of pages of mapped segments, which are neither hits nor misses,
+    /// see `BufferManagerOptions::mapped_segments`.
+    uint64_t mapped_fixes = 0;
+    /// Fixes of frames on the NUMA node of the fixing thread, and on another
+    /// node, see `BufferManagerOptions::numa`. Only counted in NUMA mode.
+    uint64_t local_fixes = 0;
+    uint64_t remote_fixes = 0;
+    /// Pages read with a checksum that does not match their data, see
+    /// `BufferManagerOptions::page_checksums`.
+    uint64_t checksum_errors = 0;
+    /// Number of `buffer_full_error` exceptions thrown.
+    uint64_t buffer_full_errors = 0;
+    /// Fixes that waited for a frame because all frames were in use, and the
+    /// total time they waited in nanoseconds, see
+    /// `BufferManagerOptions::buffer_full_timeout`.
+    uint64_t full_waits = 0;
+    uint64_t full_wait_ns = 0;
+    /// Acquisitions of frame and queue latches that had to wait, and the
+    /// total time they waited in nanoseconds.
+    uint64_t latch_waits = 0;
+    uint64_t latch_wait_ns = 0;
+    /// Latencies of page reads and writes, from submission to completion.
+    LatencyHistogram read_latency;
+    LatencyHistogram write_latency;
+
+    /// Writes the statistics in a human readable form, one value per line.
+    void dump(std::ostream& out) const;
+};
+
+
+///
+/// The counters behind `BufferManagerStats`. They are sharded by thread, so
+/// threads mostly increment counters in their own cache lines, and summed up
+/// on demand.
+///
+class StatsCounters {
+public:
+    enum Counter {
+        HITS,
+        MISSES,
+        COMPRESSED_HITS,
+        COMPRESSED_STORES,
+        PROMOTIONS,
+        EVICTIONS,
+        PREFETCHES,
+        FOREGROUND_WRITES,
+        BACKGROUND_WRITES,
+        FLUSH_WRITES,
+        MAPPED_FIXES,
+        LOCAL_FIXES,
+        REMOTE_FIXES,
+        CHECKSUM_ERRORS,
+        BUFFER_FULL_ERRORS,
+        FULL_WAITS,
+        FULL_WAIT_NS,
+        LATCH_WAITS,
+        LATCH_WAIT_NS,
+        COUNTER_COUNT
+    };
+
+private:
+    static constexpr size_t shardCount = 64;
+
+    struct alignas(64) Shard {
+        std::array<std::atomic<uint64_t>, COUNTER_COUNT> counters{};
+        std::array<std::atomic<uint64_t>, LatencyHistogram::bucket_count> reads{};
+        std::array<std::atomic<uint64_t>, LatencyHistogram::bucket_count> writes{};
+    };
+
+    std::unique_ptr<Shard[]> shards;
+
+    /// Returns the shard of the calling thread. Threads are assigned to
+    /// shards round robin when they first record something.
+    static size_t getShard();
+
+public:
+    /// Constructor.
+    StatsCounters();
+
+    /// Adds `value` to `counter`.
+    void add(Counter counter, uint64_t value = 1) {
+        shards[getShard()].counters[counter].fetch_add(value, std::memory_order_relaxed);
+    }
+
+    /// Records the latency of a page read or write.
+    void record_io(bool write, std::chrono::nanoseconds latency);
+
+    /// Returns the sum of `counter` over all shards.
+    uint64_t get(Counter counter) const;
+
+    /// Sums up all shards. Concurrent updates may or may not be included.
+    BufferManagerStats collect() const;
+
+    /// Sets all counters to zero.
+    void reset();
+};
+
+}  // namespace moderndbs
+
+#endif
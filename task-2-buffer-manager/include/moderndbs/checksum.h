@@ -0,0 +1,25 @@
+#ifndef INCLUDE_MODERNDBS_CHECKSUM_H_
+#define INCLUDE_MODERNDBS_CHECKSUM_H_
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace moderndbs {
+
+/// Returns the CRC32C (Castagnoli polynomial, as used by iSCSI and ext4) of
+/// `size` bytes of `data`, continuing from the CRC `crc` of preceding bytes.
+/// Uses the SSE4.2 `crc32` instruction when the CPU has it and
+/// `crc32c_software()` otherwise.
+uint32_t crc32c(const char* data, size_t size, uint32_t crc = 0);
+
+/// `crc32c()` with lookup tables only, eight bytes at a time. Produces the
+/// same result on every CPU.
+uint32_t crc32c_software(const char* data, size_t size, uint32_t crc = 0);
+
+/// Whether `crc32c()` uses the CPU instruction.
+bool crc32c_hardware_available();
+
+}  // namespace moderndbs
+
+#endif
@@ -0,0 +1,82 @@
+#ifndef INCLUDE_MODERNDBS_COMPRESSED_CACHE_H_
+#define INCLUDE_MODERNDBS_COMPRESSED_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+
+namespace moderndbs {
+
+///
+/// A second cache tier below the buffer pool that holds clean pages evicted
+/// from the pool in compressed form, within a memory budget. When it runs
+/// full, the pages that were evicted first are dropped. A page is taken out
+/// again when it is fixed, so it is never cached in both tiers.
+///
+/// Pages are compressed with a built-in LZ77 codec in the style of LZ4:
+/// sequences of literals followed by a match of at least 4 bytes within the
+/// last 64 KiB. It compresses runs and repeated records well and is cheap
+/// enough to be faster than reading the page.
+///
+class CompressedCache {
+private:
+    struct Entry {
+        uint64_t pageId;
+        std::vector<char> data;
+    };
+
+    size_t pageSize;
+    size_t budget;
+    /// Bytes of all compressed pages.
+    size_t used = 0;
+    /// Oldest entry first.
+    std::list<Entry> entries;
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+    /// Pages that were reserved and not taken since, see `reserve()`.
+    std::unordered_set<uint64_t> reserved;
+    std::mutex mutex;
+
+public:
+    /// Constructor.
+    /// @param[in] page_size Size of all pages in bytes.
+    /// @param[in] budget    Maximum size of all compressed pages in bytes.
+    CompressedCache(size_t page_size, size_t budget);
+
+    /// Announces that `page_id` is evicted and will be inserted. Must be
+    /// called while the page cannot be fixed yet, so a fix in between can
+    /// cancel the insert. Is thread-safe.
+    void reserve(uint64_t page_id);
+
+    /// Compresses a page and stores it when it was reserved and not taken
+    /// since. Pages that do not compress to less than the page size are not
+    /// stored. Returns whether the page was stored. Is thread-safe.
+    bool insert(uint64_t page_id, const char* data);
+
+    /// Removes a page and returns its compressed data, which is empty when
+    /// the page was not cached. Cancels a reservation. Is thread-safe.
+    std::vector<char> take(uint64_t page_id);
+
+    /// Returns the number of cached pages. Is thread-safe.
+    size_t get_page_count();
+
+    /// Returns the size of all compressed pages in bytes. Is thread-safe.
+    size_t get_size();
+
+    /// Compresses `size` bytes of `data` into `out`. Returns the compressed
+    /// size, or 0 when it would exceed `capacity`.
+    static size_t compress(const char* data, size_t size, char* out, size_t capacity);
+
+    /// Decompresses `size` bytes of `data`, which `compress()` produced from
+    /// `out_size` bytes, into `out`.
+    static void decompress(const char* data, size_t size, char* out, size_t out_size);
+};
+
+}  // namespace moderndbs
+
+#endif
@@ -15,11 +15,38 @@ public:
     /// File mode (read or write)
     enum Mode { READ, WRITE };
 
+    /// How blocks move between memory, the OS page cache and the disk.
+    enum IOMode {
+        /// Blocks go through the page cache and every write is durable when
+        /// `write_block()` returns (O_SYNC).
+        SYNC,
+        /// Blocks go through the page cache, writes only become durable with
+        /// `sync()`.
+        BUFFERED,
+        /// Blocks bypass the page cache (O_DIRECT). Offsets, sizes and block
+        /// memory must be multiples of `DIRECT_ALIGNMENT`. Writes only become
+        /// durable with `sync()`.
+        DIRECT
+    };
+
+    /// Alignment of offsets, sizes and block memory in `DIRECT` mode.
+    static constexpr size_t DIRECT_ALIGNMENT = 4096;
+
+    /// A piece of memory for the vectored `read_blocks()` and
+    /// `write_blocks()`.
+    struct Block {
+        char* data;
+        size_t size;
+    };
+
     virtual ~File() = default;
 
     /// Returns the `Mode` this file was opened with.
     virtual Mode get_mode() const = 0;
 
+    /// Returns the `IOMode` this file was opened with.
+    virtual IOMode get_io_mode() const = 0;
+
     /// Returns the current size of the file in bytes.
     /// Is not thread-safe w.r.t concurrent calls to `resize()`.
     virtual size_t size() const = 0;
@@ -61,13 +88,57 @@ public:
     /// @param[in] size   The size of the block.
     virtual void write_block(const char* block, size_t offset, size_t size) = 0;
 
+    /// Reads the adjacent blocks of the file starting at `offset` into the
+    /// memory of `blocks`, like `read_block()` for each of them but with as
+    /// few system calls as possible (preadv).
+    /// Is thread-safe w.r.t concurrent calls to `read_block()` and
+    /// `write_block()`.
+    /// @param[in] offset The offset in the file of the first block.
+    /// @param[in] blocks The memory the blocks are written to, in file order.
+    /// @param[in] count  The number of blocks.
+    virtual void read_blocks(size_t offset, const Block* blocks, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            read_block(offset, blocks[i].size, blocks[i].data);
+            offset += blocks[i].size;
+        }
+    }
+
+    /// Writes the memory of `blocks` to adjacent blocks of the file starting
+    /// at `offset`, like `write_block()` for each of them but with as few
+    /// system calls as possible (pwritev).
+    /// This function must not be used when the file was opened in `READ` mode.
+    /// Is thread-safe w.r.t concurrent calls to `read_block()` and
+    /// `write_block()`.
+    /// @param[in] blocks The memory that is written, in file order.
+    /// @param[in] count  The number of blocks.
+    /// @param[in] offset The offset in the file of the first block.
+    virtual void write_blocks(const Block* blocks, size_t count, size_t offset) {
+        for (size_t i = 0; i < count; ++i) {
+            write_block(blocks[i].data, offset, blocks[i].size);
+            offset += blocks[i].size;
+        }
+    }
+
+    /// Makes all blocks written so far durable, without flushing metadata
+    /// that is not needed to read them back (fdatasync).
+    /// Is thread-safe w.r.t concurrent calls to `read_block()` and
+    /// `write_block()`.
+    virtual void sync() = 0;
+
+    /// Returns the file descriptor through which asynchronous I/O engines can
+    /// access the file directly, or -1 when there is none.
+    virtual int get_fd() const {
+        return -1;
+    }
+
     /// Opens a file with the given mode. Existing files are never overwritten.
     /// @param[in] filename Path to the file.
     /// @param[in] mode     `Mode` that should be used to open the file.
-    static std::unique_ptr<File> open_file(const char* filename, Mode mode);
+    /// @param[in] io_mode  `IOMode` that should be used to open the file.
+    static std::unique_ptr<File> open_file(const char* filename, Mode mode, IOMode io_mode = SYNC);
 
-    /// Opens a temporary file in `WRITE` mode. The file will be deleted
-    /// automatically after use.
+    /// Opens a temporary file in `WRITE` mode with `IOMode` `BUFFERED`. The
+    /// file will be deleted automatically after use.
     static std::unique_ptr<File> make_temporary_file();
 };
 
@@ -0,0 +1,252 @@
+#ifndef INCLUDE_MODERNDBS_LOG_MANAGER_H_
+#define INCLUDE_MODERNDBS_LOG_MANAGER_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "moderndbs/file.h"
+
+
+namespace moderndbs {
+
+///
+/// A record of the write-ahead log. Records are followed by their payload and
+/// padded to a multiple of 8 bytes. An `UPDATE` is physiological: it replaces
+/// `length` bytes at `offset` of one page and carries the bytes before and
+/// after the change. A `COMPENSATION` record logs the undo of an update in
+/// the same format, its after image is the restored before image.
+///
+struct LogRecord {
+    enum Type : uint8_t {
+        UPDATE,
+        COMMIT,
+        COMPENSATION,
+        /// A transaction is rolled back completely.
+        END,
+        CHECKPOINT
+    };
+
+    /// Size including the payload and the padding.
+    uint32_t size;
+    /// Checksum over the whole record while this field is zero.
+    uint32_t checksum;
+    uint64_t lsn;
+    uint64_t txn;
+    /// The previous record of the same transaction, 0 for the first one.
+    uint64_t prev_lsn;
+    uint64_t page_id;
+    uint32_t offset;
+    uint32_t length;
+    Type type;
+    uint8_t reserved[7];
+    /// `COMPENSATION`: the next record of the transaction to undo.
+    /// `CHECKPOINT`: the LSN recovery starts at.
+    uint64_t undo_next;
+
+    /// Returns the bytes of an `UPDATE` before the change.
+    const char* get_before() const { return reinterpret_cast<const char*>(this + 1); }
+
+    /// Returns the bytes of an `UPDATE` after the change.
+    const char* get_after() const { return get_before() + length; }
+};
+static_assert(sizeof(LogRecord) == 64, "log records must be 8-byte aligned");
+
+
+/// A transaction as seen by the log.
+struct Transaction {
+    uint64_t id;
+    /// The last record of the transaction, 0 before the first one.
+    uint64_t last_lsn = 0;
+};
+
+
+/// Optional settings of a `LogManager`.
+struct LogManagerOptions {
+    /// Size of the log buffer of each thread in bytes. Bounds the size of a
+    /// record, i.e. twice the length of an update.
+    size_t thread_buffer_size = 1 << 20;
+    /// How long the flusher collects further commits after the first one
+    /// asked for a flush, so they share the sync. Zero only batches commits
+    /// that arrive while a sync is running.
+    std::chrono::microseconds commit_delay{0};
+    /// Time between two flushes when no commit asks for one.
+    std::chrono::milliseconds flush_interval{10};
+};
+
+
+///
+/// The write-ahead log. Every thread appends to its own ring buffer without
+/// taking a latch, LSNs come from one atomic counter. A flusher thread moves
+/// all published records to the log file and syncs it once for all commits
+/// that are waiting (group commit). Records of different threads are not
+/// ordered by LSN in the file.
+///
+/// Pages start with an 8 byte header that holds the LSN of their last
+/// update. `BufferManagerOptions::wal` makes the buffer manager flush the log
+/// up to that LSN before it writes a page.
+///
+class LogManager {
+public:
+    /// Bytes at the start of every page that updates must not touch. They
+    /// hold the page LSN and the checksum of the buffer manager, see
+    /// `BufferManager::page_checksum_offset`.
+    static constexpr size_t page_header_size = 2 * sizeof(uint64_t);
+
+private:
+    /// The log buffer of one thread. Only the owning thread writes records,
+    /// only the flusher consumes them.
+    struct alignas(64) ThreadLog {
+        std::unique_ptr<char[]> ring;
+        size_t capacity;
+        /// Bytes published by the thread and consumed by the flusher.
+        std::atomic<uint64_t> head{0};
+        std::atomic<uint64_t> tail{0};
+        /// A lower bound of the LSN that is being appended, ~0 when idle.
+        std::atomic<uint64_t> pending{~0ull};
+        /// The record that is being built.
+        std::vector<char> scratch;
+
+        /// Constructor.
+        explicit ThreadLog(size_t capacity) : ring(std::make_unique<char[]>(capacity)), capacity(capacity) {}
+    };
+
+    LogManagerOptions options;
+    std::string filename;
+    std::unique_ptr<File> file;
+    size_t fileSize = 0;
+    /// Distinguishes the thread logs of different managers in threads.
+    uint64_t managerId;
+
+    std::atomic<uint64_t> nextLsn{1};
+    std::atomic<uint64_t> nextTxn{1};
+
+    /// The running transactions and the next LSN at their begin.
+    std::unordered_map<uint64_t, uint64_t> activeTxns;
+    std::mutex activeTxnsMutex;
+
+    std::vector<std::unique_ptr<ThreadLog>> threadLogs;
+    std::mutex threadLogsMutex;
+
+    /// Returns the log of the calling thread, creates it when necessary.
+    ThreadLog& getThreadLog();
+
+    /// Assigns the next LSN to the record in the scratch buffer of `log`,
+    /// copies it into the ring and publishes it. Returns the LSN.
+    uint64_t append(ThreadLog& log);
+
+    /// Logs a record of `type` that replaces `length` bytes at `offset` of
+    /// a page with `data` and applies it.
+    uint64_t logPageWrite(LogRecord::Type type, Transaction& txn, uint64_t page_id, char* page, uint32_t offset,
+        const char* data, uint32_t length, uint64_t undo_next);
+
+    /// Logs a record of `type` without payload.
+    uint64_t logTransactionEvent(LogRecord::Type type, uint64_t txn, uint64_t prev_lsn, uint64_t undo_next);
+
+    /// All records up to this LSN are durable.
+    std::atomic<uint64_t> flushedLsn{0};
+    uint64_t flushRequest = 0;
+    bool spaceWanted = false;
+    std::exception_ptr error;
+    std::atomic<uint64_t> flushCount{0};
+    std::mutex flushMutex;
+    std::condition_variable flushDone;
+
+    std::thread flusher;
+    std::condition_variable flusherWakeup;
+    bool stopFlusher = false;
+
+    /// Main loop of the flusher thread.
+    void runFlusher();
+
+    /// Writes all published records and syncs the file.
+    void flushRound();
+
+public:
+    /// Constructor. Opens or creates the log file and continues after the
+    /// last complete record, a torn record at the end is cut off.
+    /// @param[in] filename The log file.
+    /// @param[in] options  Optional settings, see `LogManagerOptions`.
+    explicit LogManager(const char* filename, const LogManagerOptions& options = {});
+
+    LogManager(const LogManager&) = delete;
+    LogManager& operator=(const LogManager&) = delete;
+
+    /// Destructor. Flushes all records. No append may run concurrently.
+    ~LogManager();
+
+    /// Starts a transaction.
+    Transaction begin();
+
+    /// Logs and applies an update of the page `page_id`, whose data is
+    /// `page` and which must be fixed exclusively: replaces `length` bytes at
+    /// `offset` by `data` and sets the page LSN to the LSN of the record,
+    /// which is returned. `offset` must not be inside the page header.
+    /// Is thread-safe.
+    uint64_t log_update(Transaction& txn, uint64_t page_id, char* page, uint32_t offset, const char* data, uint32_t length);
+
+    /// Logs and applies the undo of an update of `txn`: restores `length`
+    /// bytes at `offset` of the page to `data`, its before image, and sets
+    /// the page LSN. `undo_next` is the previous record of the undone update.
+    /// Returns the LSN of the compensation record.
+    /// Is thread-safe.
+    uint64_t log_compensation(Transaction& txn, uint64_t page_id, char* page, uint32_t offset, const char* data,
+        uint32_t length, uint64_t undo_next);
+
+    /// Logs the commit of `txn` and waits until it is durable. The pages
+    /// the transaction changed must be unfixed before.
+    /// Is thread-safe.
+    void commit(Transaction& txn);
+
+    /// Logs that all updates of `txn` were undone. Does not wait.
+    /// Is thread-safe.
+    void end(Transaction& txn);
+
+    /// Returns the smallest LSN that running and future transactions can
+    /// write, i.e. where the redo and undo of a checkpoint taken now start.
+    uint64_t get_min_active_lsn();
+
+    /// Logs a checkpoint whose recovery starts at `start_lsn` and waits
+    /// until it is durable. Returns its LSN. See `moderndbs::checkpoint()`.
+    uint64_t log_checkpoint(uint64_t start_lsn);
+
+    /// Waits until all records up to `lsn` are durable. Throws the error of
+    /// a failed write of the log.
+    /// Is thread-safe.
+    void flush(uint64_t lsn);
+
+    /// Returns the LSN up to which all records are durable.
+    uint64_t get_flushed_lsn() const { return flushedLsn.load(std::memory_order_acquire); }
+
+    /// Returns the LSN the next record gets.
+    uint64_t get_next_lsn() const { return nextLsn.load(); }
+
+    /// Returns the log file.
+    const std::string& get_filename() const { return filename; }
+
+    /// Returns the number of syncs of the log file.
+    uint64_t get_flush_count() const { return flushCount.load(std::memory_order_relaxed); }
+
+    /// Calls `callback` for every complete record of a log file in file
+    /// order. Returns the size of the valid part of the file.
+    static size_t read(const char* filename, const std::function<void(const LogRecord&)>& callback);
+
+    /// Returns the LSN in the header of a page.
+    static uint64_t get_page_lsn(const char* page);
+
+    /// Sets the LSN in the header of a page.
+    static void set_page_lsn(char* page, uint64_t lsn);
+};
+
+}  // namespace moderndbs
+
+#endif
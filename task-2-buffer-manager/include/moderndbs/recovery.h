@@ -0,0 +1,62 @@
+#ifndef INCLUDE_MODERNDBS_RECOVERY_H_
+#define INCLUDE_MODERNDBS_RECOVERY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include "moderndbs/buffer_manager.h"
+#include "moderndbs/log_manager.h"
+
+
+namespace moderndbs {
+
+/// Optional settings of `recover()`.
+struct RecoveryOptions {
+    /// Number of threads that redo updates, zero uses one per core. The
+    /// buffer manager needs at least one frame per thread.
+    size_t redo_threads = 0;
+};
+
+
+/// What `recover()` did.
+struct RecoveryStats {
+    /// The LSN of the last checkpoint's start, 1 without a checkpoint.
+    uint64_t start_lsn = 1;
+    /// Records at or after the start.
+    uint64_t scanned = 0;
+    /// Updates and compensations applied to pages.
+    uint64_t redone = 0;
+    /// Updates and compensations that the page on disk already contains.
+    uint64_t skipped = 0;
+    /// Transactions that were neither committed nor rolled back.
+    uint64_t losers = 0;
+    /// Updates of losers that were undone.
+    uint64_t undone = 0;
+};
+
+
+/// Takes a checkpoint: writes all dirty pages of `buffer_manager` and logs
+/// where recovery starts, which is the oldest LSN a running transaction can
+/// have written. Runs concurrently with transactions. Returns the LSN of the
+/// checkpoint record.
+uint64_t checkpoint(BufferManager& buffer_manager, LogManager& log);
+
+///
+/// Restarts after a crash, ARIES-style. Analysis reads the log from the
+/// start of the last checkpoint and finds the losers. Redo repeats history:
+/// every update and compensation is applied to its page unless the page LSN
+/// shows the page on disk already contains it. Pages are partitioned over
+/// the redo threads by page id, so every page is redone in LSN order by one
+/// thread. Undo rolls back the losers in reverse LSN order, logging a
+/// compensation for every undone update, so a crash during undo does not
+/// undo twice. Updates are byte ranges of pages, so slotted pages and B-tree
+/// nodes are undone alike.
+///
+/// Must run before any transaction starts, `log` must be opened on the
+/// crashed log and `buffer_manager` must use it as its `wal`. Takes a
+/// checkpoint at the end.
+///
+RecoveryStats recover(BufferManager& buffer_manager, LogManager& log, const RecoveryOptions& options = {});
+
+}  // namespace moderndbs
+
+#endif
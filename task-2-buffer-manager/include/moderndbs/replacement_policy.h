@@ -0,0 +1,86 @@
+#ifndef INCLUDE_MODERNDBS_REPLACEMENT_POLICY_H_
+#define INCLUDE_MODERNDBS_REPLACEMENT_POLICY_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+
+namespace moderndbs {
+
+class BufferFrame;
+
+///
+/// Decides which page of a buffer pool (shard) is evicted next. The buffer
+/// manager calls it while holding the queue latches of the shard, so
+/// implementations need no synchronization of their own.
+///
+/// Frames whose `referenced` bit is set were accessed without `access()`,
+/// e.g. by optimistic reads or through swizzled swips. Policies treat them as
+/// accessed when they consider them for eviction and clear the bit.
+///
+class ReplacementPolicy {
+public:
+    /// The available policies.
+    enum Kind {
+        /// A FIFO list for pages accessed once and an LRU list for pages
+        /// accessed repeatedly. Scans only flush the FIFO list.
+        TWO_Q,
+        /// A clock over all frames. A hit only sets the `referenced` bit of
+        /// its frame and does not latch the queues.
+        CLOCK,
+        /// LRU-2: evicts the page whose second to last access is the oldest.
+        /// Pages accessed only once are evicted first, in FIFO order.
+        LRU_K,
+        /// Adaptive replacement cache: balances a recency and a frequency
+        /// list by remembering the ids of recently evicted pages.
+        ARC
+    };
+
+    virtual ~ReplacementPolicy() = default;
+
+    /// Adds a frame into which a page was just loaded.
+    virtual void insert(BufferFrame* frame) = 0;
+
+    /// Records a fix of the page in `frame`. Returns true when the page moved
+    /// from the pages accessed once to the pages accessed repeatedly.
+    virtual bool access(BufferFrame* frame) = 0;
+
+    /// Whether `access()` may be called without the queue latches.
+    virtual bool latch_free_access() const {
+        return false;
+    }
+
+    /// Offers frames to `try_evict` in eviction order until it returns true,
+    /// then removes that frame and returns it. Returns nullptr when
+    /// `try_evict` rejected every frame. Referenced frames that are moved to
+    /// the pages accessed repeatedly on the way are added to `promotions`.
+    virtual BufferFrame* evict(const std::function<bool(BufferFrame*)>& try_evict, uint64_t& promotions) = 0;
+
+    /// Removes a frame that is not evicted but given up, e.g. because its
+    /// page could not be loaded.
+    virtual void remove(BufferFrame* frame) = 0;
+
+    /// Returns the number of frames in the policy.
+    virtual size_t size() const = 0;
+
+    /// Appends up to `limit` frames in approximate eviction order.
+    virtual void collect(size_t limit, std::vector<BufferFrame*>& frames) const = 0;
+
+    /// Returns the ids of the pages accessed once (`repeated` false) or
+    /// repeatedly, in eviction order. For 2Q these are the FIFO and the LRU
+    /// list. CLOCK does not distinguish them and returns all pages as
+    /// accessed once.
+    virtual std::vector<uint64_t> get_pages(bool repeated) const = 0;
+
+    /// Creates a policy.
+    /// @param[in] kind     The `Kind` of the policy.
+    /// @param[in] capacity The number of frames that are managed.
+    static std::unique_ptr<ReplacementPolicy> make(Kind kind, size_t capacity);
+};
+
+}  // namespace moderndbs
+
+#endif
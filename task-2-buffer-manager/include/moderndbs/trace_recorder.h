@@ -0,0 +1,127 @@
+#ifndef INCLUDE_MODERNDBS_TRACE_RECORDER_H_
+#define INCLUDE_MODERNDBS_TRACE_RECORDER_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "moderndbs/buffer_stats.h"
+#include "moderndbs/file.h"
+#include "moderndbs/replacement_policy.h"
+
+
+namespace moderndbs {
+
+///
+/// One page access of a trace. A trace file is a plain array of records in
+/// the byte order of the machine that recorded it.
+///
+struct TraceRecord {
+    enum Event : uint8_t {
+        FIX,
+        UNFIX
+    };
+
+    enum Mode : uint8_t {
+        SHARED,
+        EXCLUSIVE,
+        /// `BufferManager::fix_page_optimistic()`, which has no unfix.
+        OPTIMISTIC
+    };
+
+    uint64_t page_id;
+    /// Nanoseconds since the recorder was created.
+    uint64_t timestamp;
+    /// Small number of the recording thread, assigned on its first record.
+    uint32_t thread;
+    Event event;
+    Mode mode;
+    /// Whether an unfix marked the page dirty.
+    bool dirty;
+    uint8_t reserved;
+};
+static_assert(sizeof(TraceRecord) == 24, "trace records must stay compact");
+
+
+///
+/// Records page accesses into a file, see
+/// `BufferManagerOptions::trace_file`. Records are appended to a ring of
+/// chunks that a background thread writes to disk once they are full, so
+/// `record()` only reserves a slot with an atomic increment. When the writer
+/// falls behind by the whole ring, `record()` waits for it.
+///
+class TraceRecorder {
+private:
+    struct Chunk {
+        std::unique_ptr<TraceRecord[]> records;
+        /// The position of the chunk in the trace, in chunks. Slots are only
+        /// written once the chunk was recycled for that position.
+        std::atomic<uint64_t> sequence;
+        /// Number of slots written.
+        std::atomic<size_t> filled{0};
+    };
+
+    std::unique_ptr<File> file;
+    size_t chunkRecords;
+    size_t chunkCount;
+    std::unique_ptr<Chunk[]> chunks;
+    /// Number of reserved slots, i.e. the index of the next record.
+    std::atomic<uint64_t> position{0};
+    std::chrono::steady_clock::time_point start;
+    /// Set when a write failed, later records are dropped.
+    std::atomic<bool> failed{false};
+
+    std::thread writer;
+    std::mutex writerMutex;
+    std::condition_variable writerWakeup;
+    bool stopWriter = false;
+
+    /// Main loop of the writer thread.
+    void runWriter();
+
+    /// Writes the first `count` records of the chunk at `sequence`.
+    void writeChunk(uint64_t sequence, size_t count);
+
+public:
+    /// Constructor. Creates or truncates `filename`.
+    /// @param[in] filename      The trace file.
+    /// @param[in] chunk_records Number of records per chunk, i.e. per write.
+    /// @param[in] chunk_count   Number of chunks in the ring.
+    explicit TraceRecorder(const char* filename, size_t chunk_records = 4096, size_t chunk_count = 8);
+
+    TraceRecorder(const TraceRecorder&) = delete;
+    TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+    /// Destructor. Writes the remaining records. No `record()` may run
+    /// concurrently.
+    ~TraceRecorder();
+
+    /// Appends a record. Is thread-safe.
+    void record(TraceRecord::Event event, uint64_t page_id, TraceRecord::Mode mode, bool dirty = false);
+
+    /// Returns the number of records so far.
+    uint64_t get_record_count() const { return position.load(std::memory_order_relaxed); }
+
+    /// Returns whether writing the trace failed.
+    bool has_failed() const { return failed.load(std::memory_order_relaxed); }
+
+    /// Reads all records of a trace file.
+    static std::vector<TraceRecord> read(const char* filename);
+};
+
+
+/// Replays the fixes of a trace on a pool of `page_count` frames that is
+/// managed by a single `ReplacementPolicy` of kind `kind`, without any I/O.
+/// Pages that are fixed in the trace are not evicted. When every frame is
+/// fixed, the page of a miss is not cached. Returns the hits, misses,
+/// promotions and evictions.
+BufferManagerStats replay_trace(const std::vector<TraceRecord>& trace, size_t page_count, ReplacementPolicy::Kind kind);
+
+}  // namespace moderndbs
+
+#endif
@@ -1,231 +1,1508 @@
 #include "moderndbs/buffer_manager.h"
+#include "moderndbs/checksum.h"
 #include "file/posix_file.cc"
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <system_error>
 #include <thread>
 #include <iostream>
+#ifdef MODERNDBS_HAVE_NUMA
+#include <numa.h>
+#endif
 
 namespace moderndbs {
 
-    char* BufferFrame::get_data() {
-        return reinterpret_cast<char*>(data.data());
-    }
+namespace {
 
-    BufferManager::BufferManager(size_t page_size, size_t page_count) {
-        maxPage= page_count ;
-        pageCounter = 0;
-        pageSize = page_size;
+    /// Maps an anonymous, page-aligned region of `size` bytes. With
+    /// `huge_pages` explicit huge pages are tried first, then transparent huge
+    /// pages are requested for a regular mapping.
+    char* mapArena(size_t size, bool huge_pages) {
+        void* arena = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        if(huge_pages){
+            arena = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        }
+#endif
+        if(arena == MAP_FAILED){
+            arena = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if(arena == MAP_FAILED){
+                throw std::bad_alloc{};
+            }
+#ifdef MADV_HUGEPAGE
+            if(huge_pages){
+                ::madvise(arena, size, MADV_HUGEPAGE);
+            }
+#endif
+        }
+        return static_cast<char*>(arena);
     }
 
+    /// Number of remote frames an eviction in NUMA mode passes over while it
+    /// looks for a local victim.
+    constexpr size_t numaEvictWindow = 8;
 
-    BufferManager::~BufferManager() {
-        for(auto & i : fifoQueue) {
-            if(i->dirty==true){
-                saveFrame(*i);
+    /// Returns the NUMA nodes that have memory, empty when libnuma is missing
+    /// or reports that NUMA is not available.
+    std::vector<int> getMemoryNodes() {
+        std::vector<int> nodes;
+#ifdef MODERNDBS_HAVE_NUMA
+        if(::numa_available() >= 0){
+            for(int node = 0; node <= ::numa_max_node(); node++) {
+                if(::numa_bitmask_isbitset(::numa_all_nodes_ptr, static_cast<unsigned>(node))){
+                    nodes.push_back(node);
+                }
             }
-           // delete fifoQueue[i];
         }
-        fifoQueue.clear();
-        for(auto & i : lruQueue) {
-            if(i->dirty==true){
-                saveFrame(*i);
+#endif
+        return nodes;
+    }
+
+    /// Returns for every CPU the index in `nodes` of its node, or of the
+    /// closest one when its node has no memory.
+    std::vector<uint16_t> getCpuNodes([[maybe_unused]] const std::vector<int>& nodes) {
+        std::vector<uint16_t> cpuNodes;
+#ifdef MODERNDBS_HAVE_NUMA
+        cpuNodes.resize(static_cast<size_t>(std::max(::numa_num_configured_cpus(), 0)));
+        for(size_t cpu = 0; cpu < cpuNodes.size(); cpu++) {
+            int node = ::numa_node_of_cpu(static_cast<int>(cpu));
+            if(node < 0){
+                continue;
+            }
+            int bestDistance = 0;
+            for(size_t i = 0; i < nodes.size(); i++) {
+                int distance = ::numa_distance(node, nodes[i]);
+                if(i == 0 || (distance > 0 && distance < bestDistance)){
+                    bestDistance = distance;
+                    cpuNodes[cpu] = static_cast<uint16_t>(i);
+                }
+            }
+        }
+#endif
+        return cpuNodes;
+    }
+
+    /// Binds `size` bytes of not yet touched memory to a NUMA node. Best
+    /// effort, without libnuma the memory stays where the kernel puts it.
+    void bindToNode([[maybe_unused]] char* memory, [[maybe_unused]] size_t size, [[maybe_unused]] int node) {
+#ifdef MODERNDBS_HAVE_NUMA
+        ::numa_tonode_memory(memory, size, node);
+#endif
+    }
+
+    /// Returns the CRC32C of a page without its checksum field.
+    uint32_t getPageChecksum(const char* data, size_t page_size) {
+        constexpr size_t end = BufferManager::page_checksum_offset + BufferManager::page_checksum_size;
+        uint32_t crc = crc32c(data, BufferManager::page_checksum_offset);
+        return crc32c(data + end, page_size - end, crc);
+    }
+
+    /// Returns the `madvise()` advice for an access pattern.
+    int getAdvice(BufferManagerOptions::Access access) {
+        switch(access) {
+            case BufferManagerOptions::SEQUENTIAL:
+                return MADV_SEQUENTIAL;
+            case BufferManagerOptions::RANDOM:
+                return MADV_RANDOM;
+            default:
+                return MADV_NORMAL;
+        }
+    }
+
+}  // namespace
+
+    char* BufferFrame::get_data() {
+        return data;
+    }
+
+    uint64_t Swip::get_page_id() const {
+        while(true) {
+            uint64_t swip = value.load();
+            if(!(swip & swizzledBit)){
+                return swip;
+            }
+            //frames are only reused after their swip was unswizzled.
+            uint64_t page_id = reinterpret_cast<BufferFrame*>(swip & ~swizzledBit)->pageid;
+            if(value.load() == swip){
+                return page_id;
             }
-            //delete fifoQueue[i];
         }
-        lruQueue.clear();
+    }
 
+    BufferManager::BufferManager(size_t page_size, size_t page_count, const BufferManagerOptions& options)
+        : options(options), pageSize(page_size), frames(std::make_unique<BufferFrame[]>(page_count)),
+          frameCount(page_count), io(AsyncIO::make(ioQueueDepth)) {
+        if(options.io_mode == File::DIRECT && page_size % File::DIRECT_ALIGNMENT != 0){
+            throw std::invalid_argument{"page size must be a multiple of File::DIRECT_ALIGNMENT for direct I/O"};
+        }
+        if(options.page_checksums && page_size < page_checksum_offset + page_checksum_size){
+            throw std::invalid_argument{"page size is too small for a page checksum"};
+        }
+        //map segments first, a failure leaves nothing else to clean up.
+        for(auto& [segment_id, access] : options.mapped_segments) {
+            auto segment = std::make_unique<MappedSegment>();
+            int fd = ::open(std::to_string(segment_id).c_str(), O_RDONLY);
+            struct ::stat fileStat{};
+            if(fd < 0 || ::fstat(fd, &fileStat) != 0){
+                int error = errno;
+                if(fd >= 0){
+                    ::close(fd);
+                }
+                throw std::system_error{error, std::system_category()};
+            }
+            segment->size = static_cast<size_t>(fileStat.st_size);
+            if(segment->size > 0){
+                void* data = ::mmap(nullptr, segment->size, PROT_READ, MAP_SHARED, fd, 0);
+                if(data == MAP_FAILED){
+                    int error = errno;
+                    ::close(fd);
+                    throw std::system_error{error, std::system_category()};
+                }
+                segment->data = static_cast<char*>(data);
+                ::madvise(data, segment->size, getAdvice(access));
+            }
+            //the mapping keeps the file open.
+            ::close(fd);
+            segment->pageCount = segment->size / page_size;
+            segment->frames = std::make_unique<std::atomic<BufferFrame*>[]>(segment->pageCount);
+            mappedSegments.emplace(segment_id, std::move(segment));
+        }
+        //round up to whole os pages, mmap works in units of those anyway.
+        auto osPageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+        arenaSize = std::max<size_t>((page_size * page_count + osPageSize - 1) / osPageSize * osPageSize, osPageSize);
+        arena = mapArena(arenaSize, options.huge_pages);
+        //one contiguous slice of frames per node, bound before the memory is
+        //first touched. An os page on the border of two slices ends up on the
+        //second node.
+        std::vector<int> numaNodes;
+        if(options.numa){
+            numaNodes = getMemoryNodes();
+            numaNodeCount = std::max<size_t>(std::min(numaNodes.size(), page_count), 1);
+        }
+        if(numaNodeCount > 1){
+            cpuNodes = getCpuNodes(numaNodes);
+            for(size_t node = 0; node < numaNodeCount; node++) {
+                size_t begin = page_count * node / numaNodeCount * page_size / osPageSize * osPageSize;
+                size_t end = std::min(page_count * (node + 1) / numaNodeCount * page_size, arenaSize);
+                bindToNode(arena + begin, end - begin, numaNodes[node]);
+            }
+        }
+        //split the frames evenly, every shard gets at least one, and frames of
+        //every node.
+        size_t shardCount = std::max<size_t>(std::min(options.shards, page_count), 1);
+        for(size_t i = 0; i < shardCount; i++) {
+            shards.push_back(std::make_unique<Shard>(page_count / shardCount + (i < page_count % shardCount), options.replacement_policy, numaNodeCount));
+        }
+        for(size_t i = 0; i < page_count; i++) {
+            frames[i].data = arena + i * page_size;
+            frames[i].node = static_cast<uint16_t>(i * numaNodeCount / page_count);
+            shards[i % shardCount]->freeFrames[frames[i].node].push_back(&frames[i]);
+        }
+        if(options.compressed_cache_size > 0){
+            compressedCache = std::make_unique<CompressedCache>(page_size, options.compressed_cache_size);
+        }
+        if(!options.trace_file.empty()){
+            traceRecorder = std::make_unique<TraceRecorder>(options.trace_file.c_str());
+        }
+        if(options.background_writer){
+            backgroundWriter = std::thread([this] { runBackgroundWriter(); });
+        }
     }
 
-    BufferFrame::BufferFrame(size_t pageSize) {
-        data = std::vector<uint64_t>(pageSize);
 
+    BufferManager::~BufferManager() {
+        if(backgroundWriter.joinable()){
+            {
+                std::lock_guard<std::mutex> guard(backgroundWriterMutex);
+                stopBackgroundWriter = true;
+            }
+            backgroundWriterWakeup.notify_one();
+            backgroundWriter.join();
+        }
+        finishPrefetchBatches();
+        //restore the page ids in all parents before they are written.
+        std::vector<BufferFrame*> residentFrames;
+        for(auto& shard : shards) {
+            size_t begin = residentFrames.size();
+            shard->policy->collect(shard->policy->size(), residentFrames);
+            for(size_t i = begin; i < residentFrames.size(); i++) {
+                if(residentFrames[i]->swizzledSwip != nullptr){
+                    shard->pageTable.unswizzle(residentFrames[i], *residentFrames[i]->swizzledSwip);
+                }
+            }
+        }
+        //write all remaining dirty pages in one batch, adjacent ones with one
+        //request.
+        std::vector<BufferFrame*> dirtyFrames;
+        for(auto* i : residentFrames) {
+            if(i->dirty==true){
+                dirtyFrames.push_back(i);
+            }
+        }
+        std::sort(dirtyFrames.begin(), dirtyFrames.end(), [](BufferFrame* a, BufferFrame* b) { return a->pageid < b->pageid; });
+        std::vector<PageIO> writes(dirtyFrames.size());
+        std::vector<IORequest*> batch;
+        size_t extentCount = prepareExtents(writes, IORequest::WRITE, dirtyFrames);
+        for(size_t i = 0; i < extentCount; i++) {
+            batch.push_back(&writes[i].request);
+        }
+        io->submit(batch.data(), batch.size());
+        for(size_t i = 0; i < extentCount; i++) {
+            finishPageIO(writes[i]);
+        }
+        if(options.io_mode != File::SYNC){
+            for(auto& segmentFile : segmentFiles) {
+                segmentFile.second->file->sync();
+            }
+        }
+        ::munmap(arena, arenaSize);
     }
 
     void BufferManager::lockFrame(BufferFrame* frame, bool exclusive){
+        //only waiting is timed, uncontended latches stay cheap.
         if(!exclusive){
-            frame->mutex_.lock_shared();
+            if(!frame->mutex_.try_lock_shared()){
+                auto start = std::chrono::steady_clock::now();
+                frame->mutex_.lock_shared();
+                recordLatchWait(start);
+            }
         } else {
-            frame->mutex_.lock();
+            if(!frame->mutex_.try_lock()){
+                auto start = std::chrono::steady_clock::now();
+                frame->mutex_.lock();
+                recordLatchWait(start);
+            }
+            frame->exclusive = true;
+            //odd version, optimistic readers restart from now on.
+            frame->version.fetch_add(1, std::memory_order_acq_rel);
+        }
+    }
+
+    bool BufferManager::tryLockFrame(BufferFrame* frame, bool exclusive){
+        if(!exclusive){
+            return frame->mutex_.try_lock_shared();
+        }
+        if(!frame->mutex_.try_lock()){
+            return false;
         }
-        frame->exclusive = exclusive;
+        frame->exclusive = true;
+        frame->version.fetch_add(1, std::memory_order_acq_rel);
+        return true;
     }
 
     void BufferManager::unlockFrame(BufferFrame* frame, bool exclusive){
-        frame->useCounter--;
         if(!exclusive){
             frame->mutex_.unlock_shared();
         } else {
+            frame->exclusive = false;
+            frame->version.fetch_add(1, std::memory_order_release);
             frame->mutex_.unlock();
         }
+        //decrement last, as soon as the counter is zero the frame may be evicted.
+        unpinFrame(frame);
     }
 
-    BufferFrame& BufferManager::fix_page(uint64_t page_id, bool exclusive) {
-        fifoMutex.lock();
-        lruMutex.lock();
-        //first check if page is in lru queue, then we don't have to do anything else.
-        BufferFrame* frame = nullptr;
-        if(pageInLruQueue(&frame, page_id, exclusive)){
-            fifoMutex.unlock();
-            lruMutex.unlock();
-            return *frame;
+    void BufferManager::unpinFrame(BufferFrame* frame){
+        //the frame may be a victim now, wake up fixes that wait for one.
+        if(--frame->useCounter == 0 && frameWaiters > 0){
+            notifyFrameReleased();
         }
+    }
 
-        //search for pageid in fifoQueue, if it is found, save page in lruQueue and delete from fifo.
-        if(pageInFifoQueue(&frame, page_id, exclusive)){
-            fifoMutex.unlock();
-            lruMutex.unlock();
-            return *frame;
+    void BufferManager::notifyFrameReleased(){
+        std::lock_guard<std::mutex> guard(frameReleasedMutex);
+        frameReleases++;
+        frameReleased.notify_all();
+    }
+
+    void FrameList::push_back(BufferFrame* frame) {
+        frame->prev = tail;
+        frame->next = nullptr;
+        if(tail != nullptr){
+            tail->next = frame;
+        } else {
+            head = frame;
         }
+        tail = frame;
+        length++;
+    }
 
-        BufferFrame* toDelete = nullptr;
+    void FrameList::insert_before(BufferFrame* position, BufferFrame* frame) {
+        frame->prev = position->prev;
+        frame->next = position;
+        if(position->prev != nullptr){
+            position->prev->next = frame;
+        } else {
+            head = frame;
+        }
+        position->prev = frame;
+        length++;
+    }
 
-        if(pageCounter == maxPage){
+    void FrameList::remove(BufferFrame* frame) {
+        if(frame->prev != nullptr){
+            frame->prev->next = frame->next;
+        } else {
+            head = frame->next;
+        }
+        if(frame->next != nullptr){
+            frame->next->prev = frame->prev;
+        } else {
+            tail = frame->prev;
+        }
+        frame->prev = nullptr;
+        frame->next = nullptr;
+        length--;
+    }
 
-            bool couldDelete = false;
-            for(size_t i =0; i< fifoQueue.size() ; i++) {
-                if(fifoQueue[i]->useCounter == 0){
-                    couldDelete = true;
-                    if(fifoQueue[i]->dirty==true){
-                        toDelete =fifoQueue[i];
-                    }
-                    fifoQueue.erase(fifoQueue.begin() + i);
+    void FrameList::collect(size_t limit, std::vector<BufferFrame*>& frames) const {
+        for(auto* frame = head; frame != nullptr && limit > 0; frame = frame->next, limit--) {
+            frames.push_back(frame);
+        }
+    }
+
+    PageTable::PageTable(size_t capacity) {
+        //at least one bucket per frame and per partition, rounded up to a power of two.
+        unsigned bits = 0;
+        while((size_t{1} << bits) < std::max(capacity, partitionCount)) {
+            bits++;
+        }
+        bucketShift = 64 - bits;
+        buckets = std::make_unique<std::atomic<BufferFrame*>[]>(size_t{1} << bits);
+    }
+
+    size_t PageTable::getBucket(uint64_t page_id) const {
+        // Fibonacci hashing, so that consecutive pages of a segment as well as
+        // equal page numbers of different segments spread over all buckets.
+        return (page_id * 0x9E3779B97F4A7C15ull) >> bucketShift;
+    }
+
+    BufferFrame* PageTable::fixFrame(uint64_t page_id) {
+        size_t bucket = getBucket(page_id);
+        std::lock_guard<std::mutex> guard(partitions[bucket % partitionCount]);
+        for(auto* frame = buckets[bucket].load(); frame != nullptr; frame = frame->hashNext) {
+            if(frame->pageid == page_id){
+                frame->useCounter++;
+                return frame;
+            }
+        }
+        return nullptr;
+    }
+
+    BufferFrame* PageTable::findOptimistic(uint64_t page_id) const {
+        //frames are never freed, so following a chain that is concurrently
+        //modified is safe, it can only produce a stale or missing result.
+        auto* frame = buckets[getBucket(page_id)].load(std::memory_order_acquire);
+        for(; frame != nullptr; frame = frame->hashNext.load(std::memory_order_acquire)) {
+            if(frame->pageid.load(std::memory_order_relaxed) == page_id){
+                return frame;
+            }
+        }
+        return nullptr;
+    }
+
+    void PageTable::insert(BufferFrame* frame) {
+        size_t bucket = getBucket(frame->pageid);
+        std::lock_guard<std::mutex> guard(partitions[bucket % partitionCount]);
+        frame->hashNext.store(buckets[bucket].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        buckets[bucket].store(frame, std::memory_order_release);
+    }
+
+    bool PageTable::eraseUnused(BufferFrame* frame) {
+        size_t bucket = getBucket(frame->pageid);
+        std::lock_guard<std::mutex> guard(partitions[bucket % partitionCount]);
+        //children are only swizzled into fixed frames, so checking them after
+        //the use counter catches all of them.
+        if(frame->useCounter != 0 || frame->swizzledChildren != 0){
+            return false;
+        }
+        if(frame->swizzledParent != nullptr){
+            //fix_swip() pins the frame before it checks the swip again, so
+            //after unswizzling either it sees the page id or we see the pin.
+            clearSwip(frame);
+            if(frame->useCounter != 0){
+                return false;
+            }
+        }
+        unlink(bucket, frame);
+        return true;
+    }
+
+    void PageTable::erase(BufferFrame* frame) {
+        size_t bucket = getBucket(frame->pageid);
+        std::lock_guard<std::mutex> guard(partitions[bucket % partitionCount]);
+        unlink(bucket, frame);
+    }
+
+    void PageTable::unlink(size_t bucket, BufferFrame* frame) {
+        auto* link = &buckets[bucket];
+        while(link->load() != frame) {
+            link = &link->load()->hashNext;
+        }
+        //the erased frame keeps its link, so optimistic lookups that are
+        //currently on it can continue their walk.
+        link->store(frame->hashNext.load(), std::memory_order_release);
+    }
+
+    void PageTable::swizzle(BufferFrame* frame, BufferFrame* parent, Swip& swip) {
+        size_t bucket = getBucket(frame->pageid);
+        std::lock_guard<std::mutex> guard(partitions[bucket % partitionCount]);
+        if(frame->swizzledParent != nullptr){
+            return;
+        }
+        //never wait for a write of the parent, the swip is swizzled next time.
+        std::unique_lock<std::mutex> parentGuard(parent->swizzleMutex, std::try_to_lock);
+        if(!parentGuard.owns_lock()){
+            return;
+        }
+        uint64_t page_id = frame->pageid;
+        if(swip.value.compare_exchange_strong(page_id, reinterpret_cast<uint64_t>(frame) | Swip::swizzledBit)){
+            frame->swizzledParent = parent;
+            frame->swizzledSwip = &swip;
+            parent->swizzledChildren++;
+        }
+    }
+
+    void PageTable::clearSwip(BufferFrame* frame) {
+        frame->swizzledSwip->value.store(frame->pageid);
+        frame->swizzledParent->swizzledChildren--;
+        frame->swizzledParent = nullptr;
+        frame->swizzledSwip = nullptr;
+    }
+
+    void PageTable::unswizzle(BufferFrame* frame, Swip& swip) {
+        std::lock_guard<std::mutex> guard(partitions[getBucket(frame->pageid) % partitionCount]);
+        if(frame->swizzledSwip == &swip){
+            clearSwip(frame);
+        }
+    }
+
+    void PageTable::unswizzleChild(BufferFrame* frame, BufferFrame* parent) {
+        uint64_t page_id = frame->pageid;
+        std::lock_guard<std::mutex> guard(partitions[getBucket(page_id) % partitionCount]);
+        //a frame that is reused meanwhile is no child, the parent cannot get
+        //new ones.
+        if(frame->pageid == page_id && frame->swizzledParent == parent){
+            clearSwip(frame);
+        }
+    }
+
+    BufferManager::MappedSegment::~MappedSegment() {
+        for(size_t i = 0; i < pageCount; i++) {
+            delete frames[i].load();
+        }
+        if(data != nullptr){
+            ::munmap(data, size);
+        }
+    }
+
+    BufferFrame* BufferManager::fixMapped(uint64_t page_id, bool exclusive) {
+        auto it = mappedSegments.find(get_segment_id(page_id));
+        if(it == mappedSegments.end()){
+            return nullptr;
+        }
+        if(exclusive){
+            throw std::invalid_argument{"pages of mapped segments can only be fixed shared"};
+        }
+        MappedSegment& segment = *it->second;
+        uint64_t segmentPageId = get_segment_page_id(page_id);
+        if(segmentPageId >= segment.pageCount){
+            throw std::out_of_range{"page is past the end of the mapped segment"};
+        }
+        stats.add(StatsCounters::MAPPED_FIXES);
+        auto& slot = segment.frames[segmentPageId];
+        BufferFrame* frame = slot.load(std::memory_order_acquire);
+        if(frame == nullptr){
+            //racing fixes create one frame each, only one is kept.
+            auto created = std::make_unique<BufferFrame>();
+            created->data = segment.data + segmentPageId * pageSize;
+            created->pageid = page_id;
+            created->mapped = true;
+            if(slot.compare_exchange_strong(frame, created.get(), std::memory_order_acq_rel)){
+                frame = created.release();
+            }
+        }
+        return frame;
+    }
+
+    BufferFrame& BufferManager::fix_page(uint64_t page_id, bool exclusive) {
+        auto mode = exclusive ? TraceRecord::EXCLUSIVE : TraceRecord::SHARED;
+        if(!mappedSegments.empty()){
+            if(BufferFrame* frame = fixMapped(page_id, exclusive)){
+                traceFix(page_id, mode);
+                return *frame;
+            }
+        }
+        BufferFrame* frame = tryFixPage(page_id, exclusive);
+        if(frame != nullptr){
+            traceFix(page_id, mode);
+            return *frame;
+        }
+        if(options.buffer_full_timeout.count() > 0){
+            //register before scanning again, so an unfix in between either
+            //frees a victim for the next scan or wakes us up.
+            auto start = std::chrono::steady_clock::now();
+            auto deadline = start + options.buffer_full_timeout;
+            frameWaiters++;
+            while(true) {
+                uint64_t releases;
+                {
+                    std::lock_guard<std::mutex> guard(frameReleasedMutex);
+                    releases = frameReleases;
+                }
+                try {
+                    frame = tryFixPage(page_id, exclusive);
+                } catch (...) {
+                    frameWaiters--;
+                    throw;
+                }
+                //the last scan runs after the deadline, releases during the
+                //last wait are not missed.
+                if(frame != nullptr || std::chrono::steady_clock::now() >= deadline){
                     break;
                 }
+                std::unique_lock<std::mutex> lock(frameReleasedMutex);
+                frameReleased.wait_until(lock, deadline, [&] { return frameReleases != releases; });
             }
-            if(!couldDelete){
-                for(size_t i =0; i< lruQueue.size() ; i++) {
-                    if(lruQueue[i]->useCounter == 0){
-                        couldDelete = true;
-                        if(lruQueue[i]->dirty==true){
-                            toDelete = lruQueue[i];
-                        }
-                        lruQueue.erase(lruQueue.begin() + i);
-                        break;
-                    }
-                }
-                if(!couldDelete){
-                    fifoMutex.unlock();
-                    lruMutex.unlock();
-                    throw buffer_full_error{};
+            frameWaiters--;
+            auto waited = std::chrono::steady_clock::now() - start;
+            stats.add(StatsCounters::FULL_WAITS);
+            stats.add(StatsCounters::FULL_WAIT_NS, std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count());
+            if(frame != nullptr){
+                traceFix(page_id, mode);
+                return *frame;
+            }
+        }
+        stats.add(StatsCounters::MISSES);
+        stats.add(StatsCounters::BUFFER_FULL_ERRORS);
+        throw buffer_full_error{};
+    }
+
+    BufferFrame* BufferManager::tryFixPage(uint64_t page_id, bool exclusive) {
+        Shard& shard = getShard(page_id);
+        auto latchHit = [&](BufferFrame* frame) {
+            //frames that are read ahead stay latched until their batch is
+            //finished, and the miss that submitted it does not wait for it.
+            bool latched = false;
+            if(prefetchBatchCount > 0){
+                latched = tryLockFrame(frame, exclusive);
+                if(!latched){
+                    finishPrefetchBatches();
                 }
             }
+            if(!latched){
+                lockFrame(frame, exclusive);
+            }
+            //the frame was still loading and its read failed, see releaseFrame().
+            if(frame->pageid != page_id){
+                unlockFrame(frame, exclusive);
+                return tryFixPage(page_id, exclusive);
+            }
+            stats.add(StatsCounters::HITS);
+            recordNumaFix(frame);
+            return frame;
+        };
+        //first check the page table, a hit only latches one partition of it.
+        BufferFrame* frame = shard.pageTable.fixFrame(page_id);
+        if(frame != nullptr){
+            if(shard.policy->latch_free_access()){
+                touchFrame(shard, frame);
+            } else {
+                lockQueues(shard);
+                touchFrame(shard, frame);
+                unlockQueues(shard);
+            }
+            return latchHit(frame);
+        }
 
-        } else {
-            pageCounter++;
+        lockQueues(shard);
+        //another thread could have loaded the page while we waited for the queues.
+        frame = shard.pageTable.fixFrame(page_id);
+        if(frame != nullptr){
+            touchFrame(shard, frame);
+            unlockQueues(shard);
+            return latchHit(frame);
         }
 
-        auto* newFrame = new BufferFrame(pageSize);
+        //a dirty page that was just evicted must not be read again before its
+        //write-back finished.
+        {
+            std::unique_lock<std::mutex> writingLock(writingPagesMutex);
+            auto isWriting = [&] {
+                return std::find(writingPages.begin(), writingPages.end(), page_id) != writingPages.end();
+            };
+            if(isWriting()){
+                unlockQueues(shard);
+                writingPagesDone.wait(writingLock, [&] { return !isWriting(); });
+                writingLock.unlock();
+                return tryFixPage(page_id, exclusive);
+            }
+        }
 
+        //take a free frame, or recycle the coldest unused one, preferably on
+        //the node of this thread.
+        uint16_t node = getCurrentNode();
+        BufferFrame* newFrame = takeFreeFrame(shard, node);
+        bool victimDirty = false;
+        bool victimCached = false;
+        uint64_t victimPage = 0;
+        if(newFrame == nullptr){
+            newFrame = evictFrame(shard, false, node);
+            if(newFrame == nullptr){
+                unlockQueues(shard);
+                //frames of finished read-ahead batches are pinned until the
+                //batches are finished.
+                if(prefetchBatchCount > 0){
+                    finishPrefetchBatches();
+                    return tryFixPage(page_id, exclusive);
+                }
+                return nullptr;
+            }
+            stats.add(StatsCounters::EVICTIONS);
+            victimDirty = newFrame->dirty;
+            victimPage = newFrame->pageid;
+            if(victimDirty){
+                std::lock_guard<std::mutex> guard(writingPagesMutex);
+                writingPages.push_back(victimPage);
+            } else if(compressedCache){
+                //reserved under the queue latch, so a miss on the victim
+                //before it is stored cancels the store.
+                compressedCache->reserve(victimPage);
+                victimCached = true;
+            }
+        }
+
+        stats.add(StatsCounters::MISSES);
+        recordNumaFix(newFrame);
+        std::vector<char> compressed;
+        if(compressedCache){
+            compressed = compressedCache->take(page_id);
+        }
+
+        //latch before the frame changes its page, so optimistic readers of the
+        //old page fail their validation.
+        //fix_swip() may still briefly pin the evicted frame, so add to the counter.
+        newFrame->useCounter+=2;
+        lockFrame(newFrame, true);
         newFrame->pageid=page_id;
-        newFrame->useCounter=2;
         newFrame->dirty=false;
-        newFrame->exclusive=exclusive;
-        lockFrame(newFrame, true);
+        newFrame->referenced=false;
+        newFrame->prefetched=false;
+
+        //the frame is locked exclusively until it is loaded, so threads that
+        //find it in the page table wait for the read to finish.
+        shard.pageTable.insert(newFrame);
+        shard.policy->insert(newFrame);
 
-        fifoQueue.push_back(newFrame);
+        unlockQueues(shard);
 
-        fifoMutex.unlock();
-        lruMutex.unlock();
+        //the frame is latched, so the victim is compressed before the read
+        //overwrites it.
+        if(victimCached && compressedCache->insert(victimPage, newFrame->get_data())){
+            stats.add(StatsCounters::COMPRESSED_STORES);
+        }
 
-        if(toDelete != nullptr){
-            saveFrame(*toDelete);
+        //a miss on the page after the previous miss, or after the previous
+        //read-ahead window, continues a scan. The batch is announced before
+        //its frames are claimed and handed over after its submission, see
+        //finishPrefetchBatches().
+        std::unique_ptr<PrefetchBatch> ahead;
+        std::unique_lock<std::mutex> aheadLock;
+        if(options.read_ahead > 0){
+            auto& sequentialMiss = getSegmentFile(get_segment_id(page_id)).sequentialMiss;
+            if(sequentialMiss.exchange(page_id + 1) == page_id){
+                aheadLock = std::unique_lock<std::mutex>(prefetchBatchesMutex);
+                prefetchBatchCount++;
+                ahead = std::make_unique<PrefetchBatch>();
+                try {
+                    claimPrefetchFrames(page_id + 1, options.read_ahead, ahead->frames);
+                } catch (...) {
+                    //read-ahead is best effort.
+                }
+                sequentialMiss = page_id + 1 + options.read_ahead;
+                if(ahead->frames.empty()){
+                    ahead.reset();
+                    prefetchBatchCount--;
+                    aheadLock.unlock();
+                }
+            }
         }
 
-        createFrame(*newFrame);
+        //every exit waits for the submitted requests, they must not outlive
+        //their PageIO, and gives back the frames of a read-ahead that was not
+        //submitted.
+        PageIO writeBack;
+        PageIO read;
+        bool readPending = false;
+        bool writtenBack = !victimDirty;
+        auto endWriteBack = [&] {
+            std::lock_guard<std::mutex> guard(writingPagesMutex);
+            writingPages.erase(std::find(writingPages.begin(), writingPages.end(), victimPage));
+            writingPagesDone.notify_all();
+        };
+        try {
+            //the evicted page still occupies the frame, so its write-back is
+            //linked before the read and both are submitted together. Preparing
+            //it flushes the log, which may fail as well.
+            IORequest* batch[2];
+            size_t batchSize = 0;
+            if(victimDirty){
+                preparePageIO(writeBack, IORequest::WRITE, victimPage, newFrame->get_data());
+                writeBack.request.link_next = compressed.empty();
+                batch[batchSize++] = &writeBack.request;
+            }
+            if(compressed.empty()){
+                preparePageIO(read, IORequest::READ, page_id, newFrame->get_data());
+                batch[batchSize++] = &read.request;
+            }
+            if(!ahead){
+                if(batchSize > 0){
+                    io->submit(batch, batchSize);
+                }
+            } else {
+                std::vector<IORequest*> aheadBatch(batch, batch + batchSize);
+                ahead->reads = std::vector<PageIO>(ahead->frames.size());
+                size_t extentCount = prepareExtents(ahead->reads, IORequest::READ, ahead->frames);
+                for(size_t i = 0; i < extentCount; i++) {
+                    aheadBatch.push_back(&ahead->reads[i].request);
+                }
+                io->submit(aheadBatch.data(), aheadBatch.size());
+                //the read-ahead runs on while the page is used, its frames stay
+                //latched until whoever needs them first finishes the batch.
+                prefetchBatches.push_back(std::move(ahead));
+                aheadLock.unlock();
+            }
+            readPending = compressed.empty();
+            if(victimDirty){
+                //the background writer is lagging behind, wake it up.
+                stats.add(StatsCounters::FOREGROUND_WRITES);
+                backgroundWriterWakeup.notify_one();
+                finishPageIO(writeBack);
+                writtenBack = true;
+                endWriteBack();
+            }
+            if(compressed.empty()){
+                readPending = false;
+                finishPageIO(read);
+            } else {
+                //after the write-back, which still used the frame.
+                CompressedCache::decompress(compressed.data(), compressed.size(), newFrame->get_data(), pageSize);
+                stats.add(StatsCounters::COMPRESSED_HITS);
+            }
+        } catch (...) {
+            //a failed write-back cancels the linked read, which completes anyway.
+            if(readPending){
+                try {
+                    io->wait(read.request);
+                } catch (...) {
+                }
+            }
+            if(ahead){
+                for(auto* frame : ahead->frames) {
+                    releaseFrame(getShard(frame->pageid), frame);
+                }
+                prefetchBatchCount--;
+                aheadLock.unlock();
+            }
+            //drop the pin of the caller, the latch goes with the frame.
+            newFrame->useCounter--;
+            if(writtenBack){
+                releaseFrame(shard, newFrame);
+            } else {
+                //the read was cancelled or not even submitted, so the frame
+                //still holds the victim.
+                restoreVictim(shard, newFrame, victimPage);
+                endWriteBack();
+            }
+            throw;
+        }
 
         unlockFrame(newFrame, true);
         lockFrame(newFrame, exclusive);
 
-        return *newFrame;
+        return newFrame;
     }
 
-    bool BufferManager::pageInFifoQueue(BufferFrame **frame, uint64_t page_id, bool exclusive) {
-        for(auto & i : fifoQueue){
-            if(i->pageid == page_id){
-                *frame = i;
-                (*frame)->useCounter++;
-                fifoMutex.unlock();
-                lruMutex.unlock();
-                //first try to lock the page
-                lockFrame(*frame, exclusive);
+    void BufferManager::runBackgroundWriter() {
+        std::unique_lock<std::mutex> lock(backgroundWriterMutex);
+        while(!stopBackgroundWriter) {
+            backgroundWriterWakeup.wait_for(lock, options.writer_interval);
+            if(stopBackgroundWriter){
                 break;
             }
+            lock.unlock();
+            finishPrefetchBatches();
+            cleanColdFrames();
+            lock.lock();
+        }
+    }
+
+    void BufferManager::cleanColdFrames() {
+        std::vector<BufferFrame*> candidates;
+        for(auto& shard : shards) {
+            //pin the dirty unfixed frames among the coldest ones, so they cannot
+            //be evicted while they are written.
+            std::lock_guard<std::mutex> fifoGuard(shard->fifoMutex);
+            std::lock_guard<std::mutex> lruGuard(shard->lruMutex);
+            size_t frameCount = shard->policy->size() + shard->getFreeFrameCount();
+            auto window = static_cast<size_t>(options.clean_fraction * frameCount);
+            size_t begin = candidates.size();
+            shard->policy->collect(window, candidates);
+            size_t end = begin;
+            for(size_t i = begin; i < candidates.size(); i++) {
+                BufferFrame* frame = candidates[i];
+                if(frame->dirty && frame->useCounter == 0 && shard->pageTable.fixFrame(frame->pageid) != nullptr){
+                    candidates[end++] = frame;
+                }
+            }
+            candidates.resize(end);
+        }
+
+        //adjacent pages end up in the same batch and are written with one request.
+        std::sort(candidates.begin(), candidates.end(), [](BufferFrame* a, BufferFrame* b) { return a->pageid < b->pageid; });
+        //failed pages stay dirty, they are written again on eviction.
+        std::exception_ptr error;
+        writeFrames(candidates, false, StatsCounters::BACKGROUND_WRITES, error);
+    }
+
+    void BufferManager::unswizzleChildren(BufferFrame* parent) {
+        //children are not linked from their parent, but every frame stays in
+        //the shard it was assigned to.
+        for(size_t i = 0; i < frameCount && parent->swizzledChildren != 0; i++) {
+            shards[i % shards.size()]->pageTable.unswizzleChild(&frames[i], parent);
+        }
+    }
+
+    bool BufferManager::lockForWrite(BufferFrame* frame, bool wait) {
+        //frames with swizzled children contain pointers, and no child must be
+        //swizzled while the frame is written.
+        if(wait){
+            //also waits for a concurrent write, so the page is durable once
+            //the segment file is synced.
+            frame->swizzleMutex.lock();
+            if(frame->swizzledChildren != 0){
+                unswizzleChildren(frame);
+            }
+        } else if(!frame->swizzleMutex.try_lock()){
+            return false;
+        }
+        if(frame->swizzledChildren == 0 && frame->dirty.exchange(false)){
+            return true;
+        }
+        frame->swizzleMutex.unlock();
+        return false;
+    }
+
+    size_t BufferManager::writeLatched(std::vector<PageIO>& writes, const std::vector<BufferFrame*>& latched, StatsCounters::Counter counter, std::exception_ptr& error) {
+        std::vector<IORequest*> batch;
+        size_t extentCount = prepareExtents(writes, IORequest::WRITE, latched);
+        for(size_t i = 0; i < extentCount; i++) {
+            batch.push_back(&writes[i].request);
+        }
+        io->submit(batch.data(), batch.size());
+        size_t written = 0;
+        size_t next = 0;
+        for(size_t i = 0; i < extentCount; i++) {
+            bool failed = false;
+            try {
+                finishPageIO(writes[i]);
+            } catch (const std::system_error&) {
+                failed = true;
+                if(!error){
+                    error = std::current_exception();
+                }
+            }
+            for(size_t end = next + getPageCount(writes[i]); next < end; next++) {
+                BufferFrame* frame = latched[next];
+                if(failed){
+                    frame->dirty = true;
+                } else {
+                    stats.add(counter);
+                    written++;
+                }
+                frame->swizzleMutex.unlock();
+                frame->mutex_.unlock_shared();
+                unpinFrame(frame);
+            }
+        }
+        return written;
+    }
+
+    size_t BufferManager::writeFrames(const std::vector<BufferFrame*>& candidates, bool wait, StatsCounters::Counter counter, std::exception_ptr& error) {
+        size_t batchSize = std::max<size_t>(options.write_batch_size, 1);
+        std::vector<PageIO> writes(std::min(batchSize, candidates.size()));
+        std::vector<BufferFrame*> latched;
+        std::vector<BufferFrame*> fixedExclusively;
+        size_t written = 0;
+        for(size_t begin = 0; begin < candidates.size(); begin += batchSize) {
+            size_t end = std::min(begin + batchSize, candidates.size());
+            latched.clear();
+            for(size_t i = begin; i < end; i++) {
+                BufferFrame* frame = candidates[i];
+                //a shared latch keeps writers out while the page is written.
+                if(frame->mutex_.try_lock_shared()){
+                    if(lockForWrite(frame, wait)){
+                        latched.push_back(frame);
+                        continue;
+                    }
+                    frame->mutex_.unlock_shared();
+                } else if(wait){
+                    fixedExclusively.push_back(frame);
+                    continue;
+                }
+                unpinFrame(frame);
+            }
+            written += writeLatched(writes, latched, counter, error);
+        }
+        //wait for each of them alone, a thread that holds one of them may be
+        //waiting for a frame of a batch.
+        for(BufferFrame* frame : fixedExclusively) {
+            lockFrame(frame, false);
+            if(lockForWrite(frame, true)){
+                latched.assign(1, frame);
+                written += writeLatched(writes, latched, counter, error);
+            } else {
+                frame->mutex_.unlock_shared();
+                unpinFrame(frame);
+            }
         }
+        return written;
+    }
 
-        //if the page is locked, we want to have the queues now and put the page at the end of queue
-        if(*frame!= nullptr){
-            fifoMutex.lock();
-            lruMutex.lock();
-            for(size_t i =0; i< fifoQueue.size() ; i++){
-                if(fifoQueue[i]->pageid == page_id) {
-                    fifoQueue.erase(fifoQueue.begin() + i);
-                    lruQueue.push_back(*frame);
-                    return true;
+    size_t BufferManager::flushPages(int32_t segment_id, bool wait) {
+        auto isSelected = [&](uint64_t page_id) { return segment_id < 0 || get_segment_id(page_id) == segment_id; };
+        //pin the dirty frames, so they cannot be evicted before their batch.
+        std::vector<BufferFrame*> candidates;
+        for(auto& shard : shards) {
+            lockQueues(*shard);
+            size_t begin = candidates.size();
+            shard->policy->collect(shard->policy->size(), candidates);
+            size_t end = begin;
+            for(size_t i = begin; i < candidates.size(); i++) {
+                BufferFrame* frame = candidates[i];
+                if(frame->dirty && isSelected(frame->pageid) && shard->pageTable.fixFrame(frame->pageid) != nullptr){
+                    candidates[end++] = frame;
                 }
             }
-            for(size_t i =0; i< lruQueue.size() ; i++){
-                if(lruQueue[i]->pageid == page_id) {
-                    lruQueue.erase(lruQueue.begin() + i);
-                    lruQueue.push_back(*frame);
-                    return true;
+            candidates.resize(end);
+            unlockQueues(*shard);
+        }
+        std::sort(candidates.begin(), candidates.end(), [](BufferFrame* a, BufferFrame* b) { return a->pageid < b->pageid; });
+        std::exception_ptr error;
+        size_t written = writeFrames(candidates, wait, StatsCounters::FLUSH_WRITES, error);
+        if(wait){
+            //dirty victims that fix_page() writes right now are not resident.
+            std::unique_lock<std::mutex> writingLock(writingPagesMutex);
+            writingPagesDone.wait(writingLock, [&] {
+                return std::none_of(writingPages.begin(), writingPages.end(), isSelected);
+            });
+        }
+        if(error){
+            std::rethrow_exception(error);
+        }
+        if(options.io_mode != File::SYNC){
+            std::shared_lock<std::shared_mutex> guard(segmentFilesMutex);
+            for(auto& segmentFile : segmentFiles) {
+                if(isSelected(static_cast<uint64_t>(segmentFile.first) << 48)){
+                    segmentFile.second->file->sync();
                 }
             }
+        }
+        return written;
+    }
 
-            (*frame)->useCounter--;
+    void BufferManager::recordLatchWait(std::chrono::steady_clock::time_point start) {
+        auto waited = std::chrono::steady_clock::now() - start;
+        stats.add(StatsCounters::LATCH_WAITS);
+        stats.add(StatsCounters::LATCH_WAIT_NS, std::chrono::duration_cast<std::chrono::nanoseconds>(waited).count());
+    }
 
+    void BufferManager::lockQueues(Shard& shard) {
+        if(!shard.fifoMutex.try_lock()){
+            auto start = std::chrono::steady_clock::now();
+            shard.fifoMutex.lock();
+            recordLatchWait(start);
+        }
+        if(!shard.lruMutex.try_lock()){
+            auto start = std::chrono::steady_clock::now();
+            shard.lruMutex.lock();
+            recordLatchWait(start);
         }
-        return false;
     }
 
-    void BufferManager::createFrame(BufferFrame& frame){
-        fileUseMutex.lock();
-        auto load= PosixFile::open_file(std::to_string(get_segment_id(frame.pageid)).c_str(), File::WRITE);
-        size_t start = get_segment_page_id(frame.pageid) * pageSize;
-        load->read_block(start,pageSize, frame.get_data());
-       fileUseMutex.unlock();
-    }
-
-    void BufferManager::saveFrame(BufferFrame& frame){
-        fileUseMutex.lock();
-        auto store= PosixFile::open_file(std::to_string(get_segment_id(frame.pageid)).c_str(), File::WRITE);
-        size_t start = get_segment_page_id(frame.pageid) * pageSize;
-        store->write_block(frame.get_data() , start , pageSize);
-        fileUseMutex.unlock();
-    }
-
-    bool BufferManager::pageInLruQueue(BufferFrame** frame, uint64_t pageid, bool exclusive){
-        //search for pageid in lruQueue, if it is found add the page at the end of queue
-        for(auto & i : lruQueue){
-            if(i->pageid == pageid){
-                *frame= i;
-                //increment the useCounter before unlocking the queue to avoid deletion of page
-                (*frame)->useCounter++;
-                fifoMutex.unlock();
-                lruMutex.unlock();
-                //first try to lock the page
-                lockFrame(i, exclusive);
-                break;
+    void BufferManager::unlockQueues(Shard& shard) {
+        shard.fifoMutex.unlock();
+        shard.lruMutex.unlock();
+    }
+
+    void BufferManager::touchFrame(Shard& shard, BufferFrame* frame) {
+        //a page that was read ahead is accessed for the first time. Prefetched
+        //frames are only tracked under the queue latches.
+        if(!shard.policy->latch_free_access() && frame->prefetched){
+            frame->prefetched = false;
+            return;
+        }
+        if(shard.policy->access(frame)){
+            stats.add(StatsCounters::PROMOTIONS);
+        }
+    }
+
+    size_t BufferManager::Shard::getFreeFrameCount() const {
+        size_t count = 0;
+        for(auto& list : freeFrames) {
+            count += list.size();
+        }
+        return count;
+    }
+
+    uint16_t BufferManager::getCurrentNode() const {
+        if(numaNodeCount == 1){
+            return 0;
+        }
+        int cpu = ::sched_getcpu();
+        return cpu >= 0 && static_cast<size_t>(cpu) < cpuNodes.size() ? cpuNodes[cpu] : 0;
+    }
+
+    void BufferManager::recordNumaFix(const BufferFrame* frame) {
+        if(options.numa){
+            stats.add(frame->node == getCurrentNode() ? StatsCounters::LOCAL_FIXES : StatsCounters::REMOTE_FIXES);
+        }
+    }
+
+    BufferFrame* BufferManager::takeFreeFrame(Shard& shard, uint16_t node) {
+        for(size_t i = 0; i < numaNodeCount; i++) {
+            auto& freeFrames = shard.freeFrames[(node + i) % numaNodeCount];
+            if(BufferFrame* frame = freeFrames.front()){
+                freeFrames.remove(frame);
+                return frame;
+            }
+        }
+        return nullptr;
+    }
+
+    void BufferManager::releaseFrame(Shard& shard, BufferFrame* frame) {
+        lockQueues(shard);
+        shard.pageTable.erase(frame);
+        shard.policy->remove(frame);
+        //fixes that found the frame in the page table retry once they get the latch.
+        frame->pageid = invalidPageId;
+        frame->dirty = false;
+        frame->prefetched = false;
+        shard.freeFrames[frame->node].push_back(frame);
+        unlockQueues(shard);
+        unlockFrame(frame, true);
+        //the frame is free now even if waiting fixes still pin it.
+        if(frameWaiters > 0){
+            notifyFrameReleased();
+        }
+    }
+
+    void BufferManager::restoreVictim(Shard& shard, BufferFrame* frame, uint64_t page_id) {
+        lockQueues(shard);
+        shard.pageTable.erase(frame);
+        shard.policy->remove(frame);
+        //fixes that found the frame in the page table retry once they get the latch.
+        frame->pageid = page_id;
+        frame->dirty = true;
+        shard.pageTable.insert(frame);
+        shard.policy->insert(frame);
+        unlockQueues(shard);
+        unlockFrame(frame, true);
+    }
+
+    BufferFrame* BufferManager::evictFrame(Shard& shard, bool clean_only, uint16_t node) {
+        size_t skipped = 0;
+        uint64_t promotions = 0;
+        BufferFrame* frame = shard.policy->evict([&](BufferFrame* victim) {
+            if(clean_only && victim->dirty){
+                return false;
+            }
+            //a cold remote frame is still better than a hot local one.
+            if(victim->node != node && skipped < numaEvictWindow && victim->useCounter == 0 && numaNodeCount > 1){
+                skipped++;
+                return false;
+            }
+            //the page table re-checks the use counter under its latch, so a
+            //concurrent hit on the victim cannot slip in between.
+            return victim->useCounter == 0 && shard.pageTable.eraseUnused(victim);
+        }, promotions);
+        //second chances stand in for the hits that only set the referenced bit.
+        if(promotions > 0){
+            stats.add(StatsCounters::PROMOTIONS, promotions);
+        }
+        return frame;
+    }
+
+    BufferFrame& BufferManager::fix_page_optimistic(uint64_t page_id, uint64_t& version) {
+        if(!mappedSegments.empty()){
+            //mapped pages never change, so every version validates.
+            if(BufferFrame* frame = fixMapped(page_id, false)){
+                version = frame->version.load(std::memory_order_relaxed);
+                traceFix(page_id, TraceRecord::OPTIMISTIC);
+                return *frame;
             }
         }
-        if(*frame != nullptr) {
-            fifoMutex.lock();
-            lruMutex.lock();
-            for (size_t i = 0; i < lruQueue.size(); i++) {
-                if (lruQueue[i]->pageid == pageid) {
-                    lruQueue.erase(lruQueue.begin() + i);
-                    lruQueue.push_back(*frame);
-                    return true;
+        bool loaded = false;
+        while(true) {
+            BufferFrame* frame = getShard(page_id).pageTable.findOptimistic(page_id);
+            if(frame == nullptr){
+                //not resident, load it the regular way and retry.
+                unfix_page(fix_page(page_id, false), false);
+                loaded = true;
+                continue;
+            }
+            version = frame->version.load(std::memory_order_acquire);
+            if((version & 1) != 0){
+                //latched exclusively, e.g. while it is loaded. A read-ahead is
+                //only unlatched when its batch is finished.
+                if(prefetchBatchCount > 0){
+                    finishPrefetchBatches();
                 }
+                std::this_thread::yield();
+                continue;
+            }
+            //the frame may have been reused for another page in the meantime.
+            if(frame->pageid.load(std::memory_order_relaxed) != page_id || !validate_page(*frame, version)){
+                continue;
+            }
+            //only write when necessary to keep the cache line shared.
+            if(!frame->referenced.load(std::memory_order_relaxed)){
+                frame->referenced.store(true, std::memory_order_relaxed);
             }
-            (*frame)->useCounter--;
+            //fix_page() already counted the access.
+            if(!loaded){
+                stats.add(StatsCounters::HITS);
+                recordNumaFix(frame);
+                traceFix(page_id, TraceRecord::OPTIMISTIC);
+            }
+            return *frame;
         }
+    }
 
-        return false;
+    BufferFrame& BufferManager::fix_swip(BufferFrame& parent, Swip& swip, bool exclusive) {
+        uint64_t value = swip.value.load(std::memory_order_acquire);
+        if(value & Swip::swizzledBit){
+            //pin the frame without the page table. Evictions unswizzle before
+            //they check the use counter, so the pin holds when the swip is
+            //still swizzled afterwards.
+            auto* frame = reinterpret_cast<BufferFrame*>(value & ~Swip::swizzledBit);
+            frame->useCounter++;
+            if(swip.value.load() != value){
+                unpinFrame(frame);
+                return fix_swip(parent, swip, exclusive);
+            }
+            lockFrame(frame, exclusive);
+            //stands in for the queue update of a hit.
+            if(!frame->referenced.load(std::memory_order_relaxed)){
+                frame->referenced.store(true, std::memory_order_relaxed);
+            }
+            stats.add(StatsCounters::HITS);
+            recordNumaFix(frame);
+            traceFix(frame->pageid, exclusive ? TraceRecord::EXCLUSIVE : TraceRecord::SHARED);
+            return *frame;
+        }
+        BufferFrame& frame = fix_page(value, exclusive);
+        //mapped frames are not in the page table, and mapped parents are
+        //read-only.
+        if(!frame.mapped && !parent.mapped){
+            getShard(value).pageTable.swizzle(&frame, &parent, swip);
+        }
+        return frame;
+    }
+
+    void BufferManager::unswizzle(BufferFrame&, Swip& swip) {
+        uint64_t value = swip.value.load();
+        if(value & Swip::swizzledBit){
+            //pin the child like fix_swip(), so its page cannot change.
+            auto* frame = reinterpret_cast<BufferFrame*>(value & ~Swip::swizzledBit);
+            frame->useCounter++;
+            if(swip.value.load() == value){
+                getShard(frame->pageid).pageTable.unswizzle(frame, swip);
+            }
+            unpinFrame(frame);
+        }
+    }
+
+    bool BufferManager::validate_page(const BufferFrame& page, uint64_t version) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return page.version.load(std::memory_order_relaxed) == version;
+    }
+
+    BufferManager::SegmentFile& BufferManager::getSegmentFile(uint16_t segment_id){
+        {
+            std::shared_lock<std::shared_mutex> guard(segmentFilesMutex);
+            auto it = segmentFiles.find(segment_id);
+            if(it != segmentFiles.end()){
+                return *it->second;
+            }
+        }
+        std::unique_lock<std::shared_mutex> guard(segmentFilesMutex);
+        auto& segmentFile = segmentFiles[segment_id];
+        if(!segmentFile){
+            auto file = File::open_file(std::to_string(segment_id).c_str(), File::WRITE, options.io_mode);
+            segmentFile = std::make_unique<SegmentFile>();
+            segmentFile->size = file->size();
+            segmentFile->file = std::move(file);
+        }
+        return *segmentFile;
+    }
+
+    void BufferManager::stampPage(char* data){
+        //write-ahead: the log must be durable up to the last update of the page.
+        if(options.wal){
+            options.wal->flush(LogManager::get_page_lsn(data));
+        }
+        //the writer has the page latched, and no fixer uses the field.
+        if(options.page_checksums){
+            uint32_t checksum = getPageChecksum(data, pageSize);
+            std::memcpy(data + page_checksum_offset, &checksum, sizeof(checksum));
+        }
+    }
+
+    void BufferManager::verifyPage(const char* data){
+        uint32_t checksum;
+        std::memcpy(&checksum, data + page_checksum_offset, sizeof(checksum));
+        if(checksum == getPageChecksum(data, pageSize)){
+            return;
+        }
+        //pages that were never written are zero.
+        if(checksum == 0 && std::all_of(data, data + pageSize, [](char c) { return c == 0; })){
+            return;
+        }
+        stats.add(StatsCounters::CHECKSUM_ERRORS);
+        throw checksum_error{};
+    }
+
+    void BufferManager::preparePageIO(PageIO& pageIO, IORequest::Kind kind, uint64_t page_id, char* data){
+        if(kind == IORequest::WRITE){
+            stampPage(data);
+        }
+        pageIO.segmentFile = &getSegmentFile(get_segment_id(page_id));
+        pageIO.fileSize = pageIO.segmentFile->size;
+        pageIO.request.kind = kind;
+        pageIO.request.file = pageIO.segmentFile->file.get();
+        pageIO.request.offset = get_segment_page_id(page_id) * pageSize;
+        pageIO.request.size = pageSize;
+        pageIO.request.block = data;
+        pageIO.request.blocks = nullptr;
+        pageIO.request.block_count = 0;
+        pageIO.request.done = false;
+        pageIO.request.error = 0;
+        pageIO.blocks.clear();
+        pageIO.start = std::chrono::steady_clock::now();
+    }
+
+    bool BufferManager::appendPage(PageIO& pageIO, uint64_t page_id, char* data){
+        auto& request = pageIO.request;
+        if(getPageCount(pageIO) >= maxExtentPages || pageIO.segmentFile != &getSegmentFile(get_segment_id(page_id))
+            || get_segment_page_id(page_id) * pageSize != request.offset + request.size){
+            return false;
+        }
+        if(request.kind == IORequest::WRITE){
+            stampPage(data);
+        }
+        if(pageIO.blocks.empty()){
+            pageIO.blocks.push_back({request.block, request.size});
+        }
+        pageIO.blocks.push_back({data, pageSize});
+        request.blocks = pageIO.blocks.data();
+        request.block_count = pageIO.blocks.size();
+        request.size += pageSize;
+        return true;
+    }
+
+    size_t BufferManager::prepareExtents(std::vector<PageIO>& pageIOs, IORequest::Kind kind, const std::vector<BufferFrame*>& frames){
+        size_t count = 0;
+        for(auto* frame : frames) {
+            if(count == 0 || !appendPage(pageIOs[count - 1], frame->pageid, frame->get_data())){
+                preparePageIO(pageIOs[count++], kind, frame->pageid, frame->get_data());
+            }
+        }
+        return count;
+    }
+
+    void BufferManager::finishPageIO(PageIO& pageIO){
+        //failed requests are timed as well.
+        auto recordLatency = [&] {
+            stats.record_io(pageIO.request.kind == IORequest::WRITE, std::chrono::steady_clock::now() - pageIO.start);
+        };
+        try {
+            io->wait(pageIO.request);
+        } catch (...) {
+            recordLatency();
+            throw;
+        }
+        recordLatency();
+        size_t start = pageIO.request.offset;
+        size_t end = start + pageIO.request.size;
+        if(pageIO.request.kind == IORequest::READ){
+            //frames are reused, so the part of a page past the end of the file
+            //has to be zeroed explicitly.
+            for(size_t i = 0; end > pageIO.fileSize && i < getPageCount(pageIO); i++) {
+                size_t pageStart = start + i * pageSize;
+                if(pageStart + pageSize > pageIO.fileSize){
+                    char* data = pageIO.blocks.empty() ? pageIO.request.block : pageIO.blocks[i].data;
+                    size_t valid = pageIO.fileSize > pageStart ? pageIO.fileSize - pageStart : 0;
+                    std::memset(data + valid, 0, pageSize - valid);
+                }
+            }
+            if(options.page_checksums){
+                for(size_t i = 0; i < getPageCount(pageIO); i++) {
+                    verifyPage(pageIO.blocks.empty() ? pageIO.request.block : pageIO.blocks[i].data);
+                }
+            }
+        } else {
+            auto& size = pageIO.segmentFile->size;
+            size_t known = size;
+            while(known < end && !size.compare_exchange_weak(known, end)) {}
+        }
+    }
+
+    void BufferManager::claimPrefetchFrames(uint64_t page_id, size_t count, std::vector<BufferFrame*>& frames){
+        //pages past the end of the file would only be zeroed.
+        auto& segmentFile = getSegmentFile(get_segment_id(page_id));
+        uint64_t segmentPage = get_segment_page_id(page_id);
+        uint64_t endPage = std::min<uint64_t>(segmentPage + count, (segmentFile.size + pageSize - 1) / pageSize);
+        uint16_t node = getCurrentNode();
+        for(uint64_t id = page_id; segmentPage < endPage; segmentPage++, id++) {
+            Shard& shard = getShard(id);
+            lockQueues(shard);
+            //pages are only inserted and erased under the queue latches, so
+            //the lookup is exact.
+            bool skip = shard.pageTable.findOptimistic(id) != nullptr;
+            if(!skip){
+                std::lock_guard<std::mutex> guard(writingPagesMutex);
+                skip = std::find(writingPages.begin(), writingPages.end(), id) != writingPages.end();
+            }
+            if(skip){
+                unlockQueues(shard);
+                continue;
+            }
+            BufferFrame* frame = takeFreeFrame(shard, node);
+            if(frame == nullptr){
+                frame = evictFrame(shard, true, node);
+                if(frame == nullptr){
+                    unlockQueues(shard);
+                    break;
+                }
+                stats.add(StatsCounters::EVICTIONS);
+            }
+            frame->useCounter++;
+            lockFrame(frame, true);
+            frame->pageid = id;
+            frame->dirty = false;
+            frame->referenced = false;
+            frame->prefetched = true;
+            //the read replaces a compressed copy.
+            if(compressedCache){
+                compressedCache->take(id);
+            }
+            shard.pageTable.insert(frame);
+            shard.policy->insert(frame);
+            unlockQueues(shard);
+            frames.push_back(frame);
+        }
+    }
+
+    std::exception_ptr BufferManager::finishPrefetch(std::vector<PageIO>& reads, const std::vector<BufferFrame*>& frames){
+        std::exception_ptr error;
+        size_t next = 0;
+        for(size_t i = 0; next < frames.size(); i++) {
+            size_t end = next + getPageCount(reads[i]);
+            try {
+                finishPageIO(reads[i]);
+            } catch (...) {
+                if(!error){
+                    error = std::current_exception();
+                }
+                for(; next < end; next++) {
+                    releaseFrame(getShard(frames[next]->pageid), frames[next]);
+                }
+                continue;
+            }
+            for(; next < end; next++) {
+                unlockFrame(frames[next], true);
+                stats.add(StatsCounters::PREFETCHES);
+            }
+        }
+        return error;
+    }
+
+    void BufferManager::finishPrefetchBatches(){
+        std::vector<std::unique_ptr<PrefetchBatch>> batches;
+        {
+            std::lock_guard<std::mutex> guard(prefetchBatchesMutex);
+            batches.swap(prefetchBatches);
+        }
+        for(auto& batch : batches) {
+            //errors of the read-ahead are not the caller's concern.
+            finishPrefetch(batch->reads, batch->frames);
+            prefetchBatchCount--;
+        }
+    }
+
+    size_t BufferManager::prefetch(uint64_t page_id, size_t count){
+        auto mapped = mappedSegments.find(get_segment_id(page_id));
+        if(mapped != mappedSegments.end()){
+            //let the kernel read the pages into its cache instead.
+            MappedSegment& segment = *mapped->second;
+            uint64_t first = get_segment_page_id(page_id);
+            if(first >= segment.pageCount){
+                return 0;
+            }
+            count = std::min<size_t>(count, segment.pageCount - first);
+            auto osPageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+            size_t begin = first * pageSize / osPageSize * osPageSize;
+            ::madvise(segment.data + begin, (first + count) * pageSize - begin, MADV_WILLNEED);
+            return count;
+        }
+        std::vector<BufferFrame*> frames;
+        claimPrefetchFrames(page_id, count, frames);
+
+        std::vector<PageIO> reads(frames.size());
+        std::vector<IORequest*> batch;
+        try {
+            size_t extentCount = prepareExtents(reads, IORequest::READ, frames);
+            for(size_t i = 0; i < extentCount; i++) {
+                batch.push_back(&reads[i].request);
+            }
+            io->submit(batch.data(), batch.size());
+        } catch (...) {
+            for(auto* frame : frames) {
+                releaseFrame(getShard(frame->pageid), frame);
+            }
+            throw;
+        }
+        if(auto error = finishPrefetch(reads, frames)){
+            std::rethrow_exception(error);
+        }
+        return frames.size();
     }
 
     void BufferManager::unfix_page(BufferFrame& page, bool is_dirty) {
+        if(page.mapped){
+            //neither latched nor pinned by fix_page().
+            if(traceRecorder){
+                traceRecorder->record(TraceRecord::UNFIX, page.pageid, TraceRecord::SHARED, is_dirty);
+            }
+            return;
+        }
 
         if(!page.dirty){
             page.dirty=is_dirty;
         }
+        //before the unlatch, afterwards the frame may hold another page.
+        if(traceRecorder){
+            traceRecorder->record(TraceRecord::UNFIX, page.pageid, page.exclusive ? TraceRecord::EXCLUSIVE : TraceRecord::SHARED, is_dirty);
+        }
 
         unlockFrame(&page, page.exclusive);
     }
@@ -233,8 +1510,9 @@ namespace moderndbs {
 
     std::vector<uint64_t> BufferManager::get_fifo_list() const {
         std::vector<uint64_t> fifo;
-        for(auto i : fifoQueue){
-            fifo.push_back(i->pageid);
+        for(auto& shard : shards){
+            auto pages = shard->policy->get_pages(false);
+            fifo.insert(fifo.end(), pages.begin(), pages.end());
         }
         return fifo;
     }
@@ -242,8 +1520,9 @@ namespace moderndbs {
 
     std::vector<uint64_t> BufferManager::get_lru_list() const {
         std::vector<uint64_t> lru;
-        for(auto i : lruQueue){
-            lru.push_back(i->pageid);
+        for(auto& shard : shards){
+            auto pages = shard->policy->get_pages(true);
+            lru.insert(lru.end(), pages.begin(), pages.end());
         }
         return lru;
     }
@@ -0,0 +1,133 @@
+#include "moderndbs/buffer_stats.h"
+#include <algorithm>
+#include <ostream>
+
+
+namespace moderndbs {
+
+size_t LatencyHistogram::get_bucket(std::chrono::nanoseconds latency) {
+    auto ns = static_cast<uint64_t>(std::max<std::chrono::nanoseconds::rep>(latency.count(), 1));
+    size_t bucket = 63 - __builtin_clzll(ns);
+    return std::min(bucket, bucket_count - 1);
+}
+
+uint64_t LatencyHistogram::count() const {
+    uint64_t count = 0;
+    for (auto bucket : buckets) {
+        count += bucket;
+    }
+    return count;
+}
+
+uint64_t LatencyHistogram::percentile(double fraction) const {
+    uint64_t total = count();
+    if (total == 0) {
+        return 0;
+    }
+    auto rank = static_cast<uint64_t>(fraction * static_cast<double>(total));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < bucket_count; ++i) {
+        seen += buckets[i];
+        if (seen > rank || seen == total) {
+            return uint64_t{1} << (i + 1);
+        }
+    }
+    return uint64_t{1} << bucket_count;
+}
+
+
+void BufferManagerStats::dump(std::ostream& out) const {
+    uint64_t fixes = hits + misses;
+    out << "hits: " << hits << '\n';
+    out << "misses: " << misses << '\n';
+    out << "hit ratio: " << (fixes == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(fixes)) << '\n';
+    out << "compressed hits: " << compressed_hits << '\n';
+    out << "compressed stores: " << compressed_stores << '\n';
+    out << "promotions: " << promotions << '\n';
+    out << "evictions: " << evictions << '\n';
+    out << "prefetches: " << prefetches << '\n';
+    out << "foreground writes: " << foreground_writes << '\n';
+    out << "background writes: " << background_writes << '\n';
+    out << "flush writes: " << flush_writes << '\n';
+    out << "mapped fixes: " << mapped_fixes << '\n';
+    out << "local fixes: " << local_fixes << '\n';
+    out << "remote fixes: " << remote_fixes << '\n';
+    out << "checksum errors: " << checksum_errors << '\n';
+    out << "buffer full errors: " << buffer_full_errors << '\n';
+    out << "full waits: " << full_waits << '\n';
+    out << "full wait ns: " << full_wait_ns << '\n';
+    out << "latch waits: " << latch_waits << '\n';
+    out << "latch wait ns: " << latch_wait_ns << '\n';
+    for (auto [name, histogram] : {std::make_pair("read", &read_latency), std::make_pair("write", &write_latency)}) {
+        out << name << " latency: count=" << histogram->count()
+            << " p50<=" << histogram->percentile(0.5) << "ns"
+            << " p99<=" << histogram->percentile(0.99) << "ns"
+            << " max<=" << histogram->percentile(1.0) << "ns" << '\n';
+    }
+}
+
+
+StatsCounters::StatsCounters() : shards(std::make_unique<Shard[]>(shardCount)) {}
+
+size_t StatsCounters::getShard() {
+    static std::atomic<size_t> nextShard{0};
+    thread_local size_t shard = nextShard.fetch_add(1, std::memory_order_relaxed) % shardCount;
+    return shard;
+}
+
+void StatsCounters::record_io(bool write, std::chrono::nanoseconds latency) {
+    auto& histogram = write ? shards[getShard()].writes : shards[getShard()].reads;
+    histogram[LatencyHistogram::get_bucket(latency)].fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t StatsCounters::get(Counter counter) const {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < shardCount; ++i) {
+        sum += shards[i].counters[counter].load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+BufferManagerStats StatsCounters::collect() const {
+    BufferManagerStats stats;
+    stats.hits = get(HITS);
+    stats.misses = get(MISSES);
+    stats.compressed_hits = get(COMPRESSED_HITS);
+    stats.compressed_stores = get(COMPRESSED_STORES);
+    stats.promotions = get(PROMOTIONS);
+    stats.evictions = get(EVICTIONS);
+    stats.prefetches = get(PREFETCHES);
+    stats.foreground_writes = get(FOREGROUND_WRITES);
+    stats.background_writes = get(BACKGROUND_WRITES);
+    stats.flush_writes = get(FLUSH_WRITES);
+    stats.mapped_fixes = get(MAPPED_FIXES);
+    stats.local_fixes = get(LOCAL_FIXES);
+    stats.remote_fixes = get(REMOTE_FIXES);
+    stats.checksum_errors = get(CHECKSUM_ERRORS);
+    stats.buffer_full_errors = get(BUFFER_FULL_ERRORS);
+    stats.full_waits = get(FULL_WAITS);
+    stats.full_wait_ns = get(FULL_WAIT_NS);
+    stats.latch_waits = get(LATCH_WAITS);
+    stats.latch_wait_ns = get(LATCH_WAIT_NS);
+    for (size_t i = 0; i < shardCount; ++i) {
+        for (size_t j = 0; j < LatencyHistogram::bucket_count; ++j) {
+            stats.read_latency.buckets[j] += shards[i].reads[j].load(std::memory_order_relaxed);
+            stats.write_latency.buckets[j] += shards[i].writes[j].load(std::memory_order_relaxed);
+        }
+    }
+    return stats;
+}
+
+void StatsCounters::reset() {
+    for (size_t i = 0; i < shardCount; ++i) {
+        for (auto& counter : shards[i].counters) {
+            counter.store(0, std::memory_order_relaxed);
+        }
+        for (size_t j = 0; j < LatencyHistogram::bucket_count; ++j) {
+            shards[i].reads[j].store(0, std::memory_order_relaxed);
+            shards[i].writes[j].store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+}  // namespace moderndbs
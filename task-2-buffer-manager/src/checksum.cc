@@ -0,0 +1,147 @@
+#include "moderndbs/checksum.h"
+#include <array>
+#include <cstring>
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#define MODERNDBS_HAVE_SSE42_CRC 1
+#endif
+
+
+namespace moderndbs {
+
+namespace {
+
+/// The reflected Castagnoli polynomial.
+constexpr uint32_t polynomial = 0x82F63B78;
+
+/// `tables[k][b]` is the CRC of byte `b` followed by `k` zero bytes, so eight
+/// bytes can be folded with eight independent lookups.
+using Tables = std::array<std::array<uint32_t, 256>, 8>;
+
+constexpr Tables makeTables() {
+    Tables tables{};
+    for (uint32_t byte = 0; byte < 256; ++byte) {
+        uint32_t crc = byte;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc >> 1) ^ (polynomial & (0u - (crc & 1)));
+        }
+        tables[0][byte] = crc;
+    }
+    for (size_t k = 1; k < 8; ++k) {
+        for (size_t byte = 0; byte < 256; ++byte) {
+            uint32_t previous = tables[k - 1][byte];
+            tables[k][byte] = (previous >> 8) ^ tables[0][previous & 0xFF];
+        }
+    }
+    return tables;
+}
+
+constexpr Tables tables = makeTables();
+
+#ifdef MODERNDBS_HAVE_SSE42_CRC
+/// Bytes per stream of one round of `crc32cHardware()`.
+constexpr size_t stripe = 256;
+
+/// Advances a CRC state over a fixed number of zero bytes. The CRC is linear,
+/// so this is a lookup per byte of the state.
+struct ShiftTable {
+    std::array<std::array<uint32_t, 256>, 4> shift;
+
+    /// Constructor.
+    explicit ShiftTable(size_t bytes) : shift() {
+        uint32_t bits[32];
+        for (unsigned bit = 0; bit < 32; ++bit) {
+            uint32_t crc = 1u << bit;
+            for (size_t i = 0; i < bytes; ++i) {
+                crc = (crc >> 8) ^ tables[0][crc & 0xFF];
+            }
+            bits[bit] = crc;
+        }
+        for (unsigned k = 0; k < 4; ++k) {
+            for (unsigned byte = 0; byte < 256; ++byte) {
+                for (unsigned bit = 0; bit < 8; ++bit) {
+                    shift[k][byte] ^= (byte >> bit & 1) ? bits[8 * k + bit] : 0;
+                }
+            }
+        }
+    }
+
+    uint32_t apply(uint32_t crc) const {
+        return shift[0][crc & 0xFF] ^ shift[1][(crc >> 8) & 0xFF] ^ shift[2][(crc >> 16) & 0xFF] ^ shift[3][crc >> 24];
+    }
+};
+
+__attribute__((target("sse4.2"))) uint32_t crc32cHardware(const char* data, size_t size, uint32_t crc) {
+    // The instruction has a latency of three cycles but a throughput of one,
+    // so three independent streams keep it busy. Their states are combined by
+    // shifting the first two over the bytes of the streams that follow.
+    static const ShiftTable shiftOne{stripe};
+    static const ShiftTable shiftTwo{2 * stripe};
+    uint64_t state = ~crc;
+    for (; size >= 3 * stripe; size -= 3 * stripe, data += 3 * stripe) {
+        uint64_t second = 0;
+        uint64_t third = 0;
+        for (size_t offset = 0; offset < stripe; offset += sizeof(uint64_t)) {
+            uint64_t words[3];
+            std::memcpy(&words[0], data + offset, sizeof(uint64_t));
+            std::memcpy(&words[1], data + stripe + offset, sizeof(uint64_t));
+            std::memcpy(&words[2], data + 2 * stripe + offset, sizeof(uint64_t));
+            state = _mm_crc32_u64(state, words[0]);
+            second = _mm_crc32_u64(second, words[1]);
+            third = _mm_crc32_u64(third, words[2]);
+        }
+        state = shiftTwo.apply(static_cast<uint32_t>(state)) ^ shiftOne.apply(static_cast<uint32_t>(second)) ^ static_cast<uint32_t>(third);
+    }
+    for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), data += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        state = _mm_crc32_u64(state, word);
+    }
+    auto state32 = static_cast<uint32_t>(state);
+    for (; size > 0; --size, ++data) {
+        state32 = _mm_crc32_u8(state32, static_cast<uint8_t>(*data));
+    }
+    return ~state32;
+}
+#endif
+
+}  // namespace
+
+
+uint32_t crc32c_software(const char* data, size_t size, uint32_t crc) {
+    crc = ~crc;
+    for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), data += sizeof(uint64_t)) {
+        // Little-endian, like the order in which the bytes are processed.
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        word ^= crc;
+        crc = tables[7][word & 0xFF] ^ tables[6][(word >> 8) & 0xFF]
+            ^ tables[5][(word >> 16) & 0xFF] ^ tables[4][(word >> 24) & 0xFF]
+            ^ tables[3][(word >> 32) & 0xFF] ^ tables[2][(word >> 40) & 0xFF]
+            ^ tables[1][(word >> 48) & 0xFF] ^ tables[0][word >> 56];
+    }
+    for (; size > 0; --size, ++data) {
+        crc = (crc >> 8) ^ tables[0][(crc ^ static_cast<uint8_t>(*data)) & 0xFF];
+    }
+    return ~crc;
+}
+
+bool crc32c_hardware_available() {
+#ifdef MODERNDBS_HAVE_SSE42_CRC
+    static const bool available = __builtin_cpu_supports("sse4.2");
+    return available;
+#else
+    return false;
+#endif
+}
+
+uint32_t crc32c(const char* data, size_t size, uint32_t crc) {
+#ifdef MODERNDBS_HAVE_SSE42_CRC
+    if (crc32c_hardware_available()) {
+        return crc32cHardware(data, size, crc);
+    }
+#endif
+    return crc32c_software(data, size, crc);
+}
+
+}  // namespace moderndbs
@@ -0,0 +1,220 @@
+#include "moderndbs/compressed_cache.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+
+
+namespace moderndbs {
+
+namespace {
+
+constexpr size_t minMatch = 4;
+constexpr size_t maxOffset = 65535;
+constexpr unsigned hashBits = 10;
+
+uint32_t load32(const char* data) {
+    uint32_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+uint64_t load64(const char* data) {
+    uint64_t value;
+    std::memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+/// Writes the sequence header, its literals and, when `match_length` is not
+/// zero, the match. Returns false when `out` is too small.
+bool writeSequence(const char* literals, size_t literal_length, size_t offset, size_t match_length,
+    char*& out, const char* out_end) {
+    auto writeLength = [&](size_t length) {
+        for (; length >= 255; length -= 255) {
+            if (out == out_end) {
+                return false;
+            }
+            *out++ = static_cast<char>(255);
+        }
+        if (out == out_end) {
+            return false;
+        }
+        *out++ = static_cast<char>(length);
+        return true;
+    };
+    if (out == out_end) {
+        return false;
+    }
+    size_t matchCode = match_length == 0 ? 0 : match_length - minMatch;
+    *out++ = static_cast<char>((std::min<size_t>(literal_length, 15) << 4) | std::min<size_t>(matchCode, 15));
+    if (literal_length >= 15 && !writeLength(literal_length - 15)) {
+        return false;
+    }
+    if (static_cast<size_t>(out_end - out) < literal_length) {
+        return false;
+    }
+    std::memcpy(out, literals, literal_length);
+    out += literal_length;
+    if (match_length == 0) {
+        return true;
+    }
+    if (out_end - out < 2) {
+        return false;
+    }
+    *out++ = static_cast<char>(offset & 0xFF);
+    *out++ = static_cast<char>(offset >> 8);
+    return matchCode < 15 || writeLength(matchCode - 15);
+}
+
+}  // namespace
+
+
+CompressedCache::CompressedCache(size_t page_size, size_t budget) : pageSize(page_size), budget(budget) {}
+
+void CompressedCache::reserve(uint64_t page_id) {
+    std::lock_guard<std::mutex> guard(mutex);
+    reserved.insert(page_id);
+}
+
+bool CompressedCache::insert(uint64_t page_id, const char* data) {
+    // Compress without the latch, most of the work of an insert.
+    thread_local std::vector<char> buffer;
+    buffer.resize(pageSize);
+    size_t size = compress(data, pageSize, buffer.data(), pageSize - 1);
+    std::vector<char> compressed(buffer.begin(), buffer.begin() + static_cast<std::ptrdiff_t>(size));
+    std::lock_guard<std::mutex> guard(mutex);
+    if (reserved.erase(page_id) == 0 || size == 0 || size > budget) {
+        return false;
+    }
+    while (used + size > budget) {
+        used -= entries.front().data.size();
+        index.erase(entries.front().pageId);
+        entries.pop_front();
+    }
+    used += size;
+    entries.push_back(Entry{page_id, std::move(compressed)});
+    index[page_id] = std::prev(entries.end());
+    return true;
+}
+
+std::vector<char> CompressedCache::take(uint64_t page_id) {
+    std::lock_guard<std::mutex> guard(mutex);
+    reserved.erase(page_id);
+    auto it = index.find(page_id);
+    if (it == index.end()) {
+        return {};
+    }
+    std::vector<char> data = std::move(it->second->data);
+    used -= data.size();
+    entries.erase(it->second);
+    index.erase(it);
+    return data;
+}
+
+size_t CompressedCache::get_page_count() {
+    std::lock_guard<std::mutex> guard(mutex);
+    return entries.size();
+}
+
+size_t CompressedCache::get_size() {
+    std::lock_guard<std::mutex> guard(mutex);
+    return used;
+}
+
+size_t CompressedCache::compress(const char* data, size_t size, char* out, size_t capacity) {
+    // Positions plus one of the last occurrences of 4-byte sequences.
+    uint32_t table[1u << hashBits] = {};
+    char* outBegin = out;
+    const char* outEnd = out + capacity;
+    size_t anchor = 0;
+    size_t position = 0;
+    while (position + minMatch <= size) {
+        uint32_t sequence = load32(data + position);
+        uint32_t hash = (sequence * 2654435761u) >> (32 - hashBits);
+        size_t candidate = table[hash];
+        table[hash] = static_cast<uint32_t>(position + 1);
+        if (candidate == 0 || position - (candidate - 1) > maxOffset || load32(data + candidate - 1) != sequence) {
+            ++position;
+            continue;
+        }
+        size_t match = candidate - 1;
+        size_t length = minMatch;
+        // Eight bytes at a time, then the rest.
+        while (position + length + sizeof(uint64_t) <= size
+            && load64(data + match + length) == load64(data + position + length)) {
+            length += sizeof(uint64_t);
+        }
+        while (position + length < size && data[match + length] == data[position + length]) {
+            ++length;
+        }
+        if (!writeSequence(data + anchor, position - anchor, position - match, length, out, outEnd)) {
+            return 0;
+        }
+        position += length;
+        anchor = position;
+    }
+    if (!writeSequence(data + anchor, size - anchor, 0, 0, out, outEnd)) {
+        return 0;
+    }
+    return static_cast<size_t>(out - outBegin);
+}
+
+void CompressedCache::decompress(const char* data, size_t size, char* out, size_t out_size) {
+    const char* end = data + size;
+    size_t written = 0;
+    auto readLength = [&](size_t length) {
+        uint8_t byte;
+        do {
+            if (data == end) {
+                throw std::runtime_error{"truncated compressed page"};
+            }
+            byte = static_cast<uint8_t>(*data++);
+            length += byte;
+        } while (byte == 255);
+        return length;
+    };
+    while (data < end) {
+        auto token = static_cast<uint8_t>(*data++);
+        size_t literalLength = token >> 4;
+        if (literalLength == 15) {
+            literalLength = readLength(literalLength);
+        }
+        if (literalLength > static_cast<size_t>(end - data) || literalLength > out_size - written) {
+            throw std::runtime_error{"corrupt compressed page"};
+        }
+        std::memcpy(out + written, data, literalLength);
+        data += literalLength;
+        written += literalLength;
+        if (data == end) {
+            break;
+        }
+        if (end - data < 2) {
+            throw std::runtime_error{"truncated compressed page"};
+        }
+        size_t offset = static_cast<uint8_t>(data[0]) | (static_cast<size_t>(static_cast<uint8_t>(data[1])) << 8);
+        data += 2;
+        size_t matchLength = token & 15;
+        if (matchLength == 15) {
+            matchLength = readLength(matchLength);
+        }
+        matchLength += minMatch;
+        if (offset == 0 || offset > written || matchLength > out_size - written) {
+            throw std::runtime_error{"corrupt compressed page"};
+        }
+        // The match may overlap the bytes it produces, i.e. repeat a pattern
+        // of `offset` bytes. Every copy doubles the repeated part, so each
+        // one can read bytes that are complete already.
+        size_t source = written - offset;
+        while (matchLength > 0) {
+            size_t chunk = std::min(matchLength, written - source);
+            std::memcpy(out + written, out + source, chunk);
+            written += chunk;
+            matchLength -= chunk;
+        }
+    }
+    if (written != out_size) {
+        throw std::runtime_error{"corrupt compressed page"};
+    }
+}
+
+}  // namespace moderndbs
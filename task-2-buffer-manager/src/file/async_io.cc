@@ -0,0 +1,442 @@
+#include "moderndbs/async_io.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+// Define MODERNDBS_DISABLE_IO_URING to always use the thread pool engine.
+#if !defined(MODERNDBS_DISABLE_IO_URING) && defined(__linux__) && defined(__NR_io_uring_setup) && defined(__NR_io_uring_register) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+#include <cstddef>
+#define MODERNDBS_HAVE_IO_URING 1
+#endif
+
+
+namespace moderndbs {
+
+namespace {
+
+/// Executes a request with the blocking `File` API.
+void execute(IORequest& request) {
+    try {
+        if (request.blocks != nullptr) {
+            if (request.kind == IORequest::READ) {
+                request.file->read_blocks(request.offset, request.blocks, request.block_count);
+            } else {
+                request.file->write_blocks(request.blocks, request.block_count, request.offset);
+            }
+        } else if (request.kind == IORequest::READ) {
+            request.file->read_block(request.offset, request.size, request.block);
+        } else {
+            request.file->write_block(request.block, request.offset, request.size);
+        }
+    } catch (const std::system_error& e) {
+        request.error = e.code().value();
+    }
+}
+
+/// Returns the number of requests starting at `requests[0]` that are linked
+/// together.
+size_t chain_length(IORequest* const* requests, size_t count) {
+    size_t length = 1;
+    while (length < count && requests[length - 1]->link_next) {
+        ++length;
+    }
+    return length;
+}
+
+
+class ThreadPoolIO
+: public AsyncIO {
+private:
+    std::mutex mutex;
+    std::condition_variable queued;
+    std::condition_variable completed;
+    /// Chains of linked requests that are waiting for a thread.
+    std::deque<std::vector<IORequest*>> chains;
+    std::vector<std::thread> threads;
+    bool stopping = false;
+
+    void run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            queued.wait(lock, [&] { return stopping || !chains.empty(); });
+            if (chains.empty()) {
+                return;
+            }
+            auto chain = std::move(chains.front());
+            chains.pop_front();
+            lock.unlock();
+            bool failed = false;
+            for (auto* request : chain) {
+                if (failed) {
+                    request->error = ECANCELED;
+                } else {
+                    execute(*request);
+                    failed = request->error != 0;
+                }
+                std::lock_guard<std::mutex> guard(mutex);
+                request->done = true;
+                completed.notify_all();
+            }
+            lock.lock();
+        }
+    }
+
+public:
+    explicit ThreadPoolIO(unsigned thread_count) {
+        for (unsigned i = 0; i < std::max(thread_count, 1u); ++i) {
+            threads.emplace_back([this] { run(); });
+        }
+    }
+
+    ~ThreadPoolIO() override {
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            stopping = true;
+        }
+        queued.notify_all();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    void submit(IORequest* const* requests, size_t count) override {
+        {
+            std::lock_guard<std::mutex> guard(mutex);
+            for (size_t i = 0; i < count;) {
+                size_t length = chain_length(requests + i, count - i);
+                chains.emplace_back(requests + i, requests + i + length);
+                i += length;
+            }
+        }
+        queued.notify_all();
+    }
+
+    void wait(IORequest& request) override {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            completed.wait(lock, [&] { return request.done.load(); });
+        }
+        if (request.error != 0) {
+            throw std::system_error{request.error, std::system_category()};
+        }
+    }
+};
+
+
+#ifdef MODERNDBS_HAVE_IO_URING
+
+[[noreturn]] void throw_errno() {
+    throw std::system_error{errno, std::system_category()};
+}
+
+// Vectored requests pass their blocks to the kernel as iovecs.
+static_assert(sizeof(File::Block) == sizeof(::iovec), "File::Block must match iovec");
+static_assert(offsetof(File::Block, data) == offsetof(::iovec, iov_base), "File::Block must match iovec");
+static_assert(offsetof(File::Block, size) == offsetof(::iovec, iov_len), "File::Block must match iovec");
+
+class IoUringIO
+: public AsyncIO {
+private:
+    int ring_fd;
+    unsigned entries;
+    /// Number of requests in the submission queue or in flight, at most
+    /// `entries` so that neither queue can overflow.
+    std::atomic<unsigned> in_flight{0};
+    /// Requests that were queued but not passed to the kernel yet.
+    unsigned pending = 0;
+
+    void* sq_ring = MAP_FAILED;
+    size_t sq_ring_size;
+    void* cq_ring = MAP_FAILED;
+    size_t cq_ring_size;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    size_t sqes_size;
+
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    io_uring_cqe* cqes;
+
+    /// `submit_mutex` protects the submission queue, `reap_mutex` the
+    /// completion queue. Waiting in the kernel only holds `reap_mutex`.
+    std::mutex submit_mutex;
+    std::mutex reap_mutex;
+
+    int enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+        int result;
+        do {
+            result = static_cast<int>(::syscall(
+                __NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0
+            ));
+        } while (result < 0 && errno == EINTR);
+        return result;
+    }
+
+    /// Passes all pending requests to the kernel. Requires `submit_mutex`.
+    void flush() {
+        while (pending > 0) {
+            int submitted = enter(pending, 0, 0);
+            if (submitted < 0) {
+                if (errno != EAGAIN && errno != EBUSY) {
+                    throw_errno();
+                }
+                // The kernel is out of resources, make room by completing
+                // requests.
+                std::lock_guard<std::mutex> guard(reap_mutex);
+                reap(in_flight != pending);
+                continue;
+            }
+            pending -= static_cast<unsigned>(submitted);
+        }
+    }
+
+    /// Completes all requests in the completion queue. With `block` waits for
+    /// at least one completion first. Requires `reap_mutex`.
+    void reap(bool block) {
+        if (block && enter(0, 1, IORING_ENTER_GETEVENTS) < 0) {
+            throw_errno();
+        }
+        unsigned head = *cq_head;
+        unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+        unsigned reaped = tail - head;
+        for (; head != tail; ++head) {
+            auto& cqe = cqes[head & *cq_mask];
+            complete(*reinterpret_cast<IORequest*>(cqe.user_data), cqe.res);
+        }
+        __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+        in_flight -= reaped;
+    }
+
+    /// Throws when the kernel does not support one of the opcodes used by
+    /// `submit()`. Rings can be set up on kernels that lack some of them, and
+    /// every request would then fail with EINVAL.
+    void checkOpcodes() {
+        constexpr unsigned op_count = 256;
+        std::vector<char> buffer(sizeof(io_uring_probe) + op_count * sizeof(io_uring_probe_op));
+        auto* probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+        if (::syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PROBE, probe, op_count) < 0) {
+            throw_errno();
+        }
+        for (unsigned op : {IORING_OP_READ, IORING_OP_WRITE, IORING_OP_READV, IORING_OP_WRITEV}) {
+            if (op > probe->last_op || (probe->ops[op].flags & IO_URING_OP_SUPPORTED) == 0) {
+                throw std::system_error{EINVAL, std::system_category()};
+            }
+        }
+    }
+
+    static void complete(IORequest& request, int result) {
+        if (result < 0) {
+            request.error = -result;
+        } else if (request.kind == IORequest::WRITE && static_cast<size_t>(result) < request.size) {
+            // Short writes are rare, finish them with the blocking API.
+            IORequest rest;
+            rest.kind = IORequest::WRITE;
+            rest.file = request.file;
+            rest.offset = request.offset + result;
+            rest.size = request.size - result;
+            std::vector<File::Block> rest_blocks;
+            if (request.blocks != nullptr) {
+                size_t skip = static_cast<size_t>(result);
+                for (size_t i = 0; i < request.block_count; ++i) {
+                    auto block = request.blocks[i];
+                    if (skip >= block.size) {
+                        skip -= block.size;
+                        continue;
+                    }
+                    rest_blocks.push_back({block.data + skip, block.size - skip});
+                    skip = 0;
+                }
+                rest.blocks = rest_blocks.data();
+                rest.block_count = rest_blocks.size();
+            } else {
+                rest.block = request.block + result;
+            }
+            execute(rest);
+            request.error = rest.error;
+        }
+        // Short reads only happen at the end of the file, just like
+        // `File::read_block()` they leave the rest of the block untouched.
+        request.done.store(true, std::memory_order_release);
+    }
+
+public:
+    explicit IoUringIO(unsigned queue_depth) {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        ring_fd = static_cast<int>(::syscall(__NR_io_uring_setup, std::max(queue_depth, 1u), &params));
+        if (ring_fd < 0) {
+            throw_errno();
+        }
+        try {
+            entries = params.sq_entries;
+            sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if (single_mmap) {
+                sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+            }
+            sq_ring = ::mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+            if (sq_ring == MAP_FAILED) {
+                throw_errno();
+            }
+            if (single_mmap) {
+                cq_ring = sq_ring;
+            } else {
+                cq_ring = ::mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+                if (cq_ring == MAP_FAILED) {
+                    throw_errno();
+                }
+            }
+            sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+            sqes = static_cast<io_uring_sqe*>(::mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES));
+            if (sqes == MAP_FAILED) {
+                throw_errno();
+            }
+            checkOpcodes();
+        } catch (...) {
+            unmap();
+            throw;
+        }
+        auto* sq = static_cast<char*>(sq_ring);
+        sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        auto* cq = static_cast<char*>(cq_ring);
+        cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    }
+
+    ~IoUringIO() override {
+        unmap();
+    }
+
+    void unmap() {
+        if (sqes != MAP_FAILED) {
+            ::munmap(sqes, sqes_size);
+        }
+        if (cq_ring != MAP_FAILED && cq_ring != sq_ring) {
+            ::munmap(cq_ring, cq_ring_size);
+        }
+        if (sq_ring != MAP_FAILED) {
+            ::munmap(sq_ring, sq_ring_size);
+        }
+        ::close(ring_fd);
+    }
+
+    void submit(IORequest* const* requests, size_t count) override {
+        for (size_t i = 0; i < count; ++i) {
+            if (requests[i]->file->get_fd() < 0) {
+                // The kernel cannot access this file, run the whole batch
+                // synchronously so that links are still respected.
+                bool failed = false;
+                for (size_t j = 0; j < count; ++j) {
+                    if (failed) {
+                        requests[j]->error = ECANCELED;
+                    } else {
+                        execute(*requests[j]);
+                    }
+                    failed = requests[j]->link_next && requests[j]->error != 0;
+                    requests[j]->done.store(true, std::memory_order_release);
+                }
+                return;
+            }
+        }
+
+        std::lock_guard<std::mutex> guard(submit_mutex);
+        for (size_t i = 0; i < count;) {
+            // Chains longer than the queue are split.
+            size_t length = std::min<size_t>(chain_length(requests + i, count - i), entries);
+            while (in_flight + length > entries) {
+                flush();
+                std::lock_guard<std::mutex> reap_guard(reap_mutex);
+                // A waiter may have reaped the completions meanwhile, then
+                // blocking would never end.
+                if (in_flight + length > entries) {
+                    reap(in_flight != 0);
+                }
+            }
+            unsigned tail = *sq_tail;
+            for (size_t j = 0; j < length; ++j, ++tail) {
+                auto& request = *requests[i + j];
+                unsigned index = tail & *sq_mask;
+                auto& sqe = sqes[index];
+                std::memset(&sqe, 0, sizeof(sqe));
+                sqe.fd = request.file->get_fd();
+                sqe.off = request.offset;
+                if (request.blocks != nullptr) {
+                    sqe.opcode = request.kind == IORequest::READ ? IORING_OP_READV : IORING_OP_WRITEV;
+                    sqe.addr = reinterpret_cast<uint64_t>(request.blocks);
+                    sqe.len = static_cast<uint32_t>(request.block_count);
+                } else {
+                    sqe.opcode = request.kind == IORequest::READ ? IORING_OP_READ : IORING_OP_WRITE;
+                    sqe.addr = reinterpret_cast<uint64_t>(request.block);
+                    sqe.len = static_cast<uint32_t>(request.size);
+                }
+                sqe.user_data = reinterpret_cast<uint64_t>(&request);
+                if (j + 1 < length) {
+                    sqe.flags = IOSQE_IO_LINK;
+                }
+                sq_array[index] = index;
+            }
+            __atomic_store_n(sq_tail, tail, __ATOMIC_RELEASE);
+            in_flight += static_cast<unsigned>(length);
+            pending += static_cast<unsigned>(length);
+            i += length;
+        }
+        flush();
+    }
+
+    void wait(IORequest& request) override {
+        while (!request.done.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> guard(reap_mutex);
+            if (request.done.load(std::memory_order_acquire)) {
+                break;
+            }
+            reap(true);
+        }
+        if (request.error != 0) {
+            throw std::system_error{request.error, std::system_category()};
+        }
+    }
+};
+
+#endif
+
+}  // namespace
+
+
+std::unique_ptr<AsyncIO> AsyncIO::make(unsigned queue_depth) {
+#ifdef MODERNDBS_HAVE_IO_URING
+    try {
+        return std::make_unique<IoUringIO>(queue_depth);
+    } catch (const std::system_error&) {
+        // io_uring is not available (old kernel, seccomp, ...).
+    }
+#endif
+    return make_thread_pool(std::min(queue_depth, 8u));
+}
+
+
+std::unique_ptr<AsyncIO> AsyncIO::make_thread_pool(unsigned thread_count) {
+    return std::make_unique<ThreadPoolIO>(thread_count);
+}
+
+}  // namespace moderndbs
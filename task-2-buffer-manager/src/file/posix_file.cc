@@ -3,10 +3,17 @@
 #include <stdlib.h>  // NOLINT
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include <cerrno>
+#include <climits>
 #include <memory>
 #include <system_error>
+#include <vector>
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
 
 
 namespace moderndbs {
@@ -17,6 +24,37 @@ namespace {
     throw std::system_error{errno, std::system_category()};
 }
 
+/// Moves `blocks` between memory and the file at `offset` with as few calls
+/// of `transfer` (preadv or pwritev) as possible. Stops early when `transfer`
+/// returns 0, e.g. at the end of the file.
+template <typename Transfer>
+void transfer_blocks(const File::Block* blocks, size_t count, size_t offset, Transfer transfer) {
+    std::vector<::iovec> iov;
+    size_t block = 0;
+    size_t block_offset = 0;
+    while (block < count) {
+        iov.clear();
+        for (size_t i = block; i < count && iov.size() < IOV_MAX; ++i) {
+            size_t skip = i == block ? block_offset : 0;
+            iov.push_back({blocks[i].data + skip, blocks[i].size - skip});
+        }
+        ssize_t bytes = transfer(iov.data(), static_cast<int>(iov.size()), static_cast<off_t>(offset));
+        if (bytes == 0) {
+            return;
+        }
+        if (bytes < 0) {
+            throw_errno();
+        }
+        offset += static_cast<size_t>(bytes);
+        // Skip the blocks that were moved completely.
+        block_offset += static_cast<size_t>(bytes);
+        while (block < count && block_offset >= blocks[block].size) {
+            block_offset -= blocks[block].size;
+            ++block;
+        }
+    }
+}
+
 }  // namespace
 
 
@@ -24,6 +62,7 @@ class PosixFile
 : public File {
 private:
     Mode mode;
+    IOMode io_mode;
     int fd;
     size_t cached_size;
 
@@ -36,19 +75,39 @@ private:
     }
 
 public:
-    PosixFile(Mode mode, int fd, size_t size) : mode(mode), fd(fd), cached_size(size) {}
-
-    PosixFile(const char* filename, Mode mode) : mode(mode) {
+    PosixFile(Mode mode, IOMode io_mode, int fd, size_t size)
+    : mode(mode), io_mode(io_mode), fd(fd), cached_size(size) {}
+
+    PosixFile(const char* filename, Mode mode, IOMode io_mode) : mode(mode), io_mode(io_mode) {
+        int flags = 0;
+        switch (io_mode) {
+            case SYNC:
+                flags = O_SYNC;
+                break;
+            case BUFFERED:
+                break;
+            case DIRECT:
+#ifdef O_DIRECT
+                flags = O_DIRECT;
+#endif
+                break;
+        }
         switch (mode) {
             case READ:
-                fd = ::open(filename, O_RDONLY | O_SYNC);
+                fd = ::open(filename, O_RDONLY | flags);
                 break;
             case WRITE:
-                fd = ::open(filename, O_RDWR | O_CREAT | O_SYNC, 0666);
+                fd = ::open(filename, O_RDWR | O_CREAT | flags, 0666);
         }
         if (fd < 0) {
             throw_errno();
         }
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+        if (io_mode == DIRECT && ::fcntl(fd, F_NOCACHE, 1) < 0) {
+            ::close(fd);
+            throw_errno();
+        }
+#endif
         cached_size = read_size();
     }
 
@@ -63,10 +122,18 @@ public:
         return mode;
     }
 
+    IOMode get_io_mode() const override {
+        return io_mode;
+    }
+
     size_t size() const override {
         return cached_size;
     }
 
+    int get_fd() const override {
+        return fd;
+    }
+
     void resize(size_t new_size) override {
         if (new_size == cached_size) {
             return;
@@ -118,11 +185,33 @@ public:
             total_bytes_written += static_cast<size_t>(bytes_written);
         }
     }
+
+    void read_blocks(size_t offset, const Block* blocks, size_t count) override {
+        transfer_blocks(blocks, count, offset, [&](const ::iovec* iov, int iov_count, off_t iov_offset) {
+            return ::preadv(fd, iov, iov_count, iov_offset);
+        });
+    }
+
+    void write_blocks(const Block* blocks, size_t count, size_t offset) override {
+        transfer_blocks(blocks, count, offset, [&](const ::iovec* iov, int iov_count, off_t iov_offset) {
+            return ::pwritev(fd, iov, iov_count, iov_offset);
+        });
+    }
+
+    void sync() override {
+#ifdef __APPLE__
+        if (::fsync(fd) < 0) {
+#else
+        if (::fdatasync(fd) < 0) {
+#endif
+            throw_errno();
+        }
+    }
 };
 
 
-std::unique_ptr<File> File::open_file(const char* filename, Mode mode) {
-    return std::make_unique<PosixFile>(filename, mode);
+std::unique_ptr<File> File::open_file(const char* filename, Mode mode, IOMode io_mode) {
+    return std::make_unique<PosixFile>(filename, mode, io_mode);
 }
 
 
@@ -136,7 +225,7 @@ std::unique_ptr<File> File::make_temporary_file() {
         ::close(fd);
         throw_errno();
     }
-    return std::make_unique<PosixFile>(File::WRITE, fd, 0);
+    return std::make_unique<PosixFile>(File::WRITE, File::BUFFERED, fd, 0);
 }
 
 }  // namespace moderndbs
@@ -13,9 +13,9 @@ set(SRC_CC_LINTER_IGNORE "")
 # Files
 # ---------------------------------------------------------------------------
 
-set(SRC_CC src/buffer_manager.cc)
+set(SRC_CC src/buffer_manager.cc src/buffer_stats.cc src/checksum.cc src/compressed_cache.cc src/log_manager.cc src/recovery.cc src/replacement_policy.cc src/trace_recorder.cc)
 if(UNIX)
-    set(SRC_CC ${SRC_CC} src/file/posix_file.cc)
+    set(SRC_CC ${SRC_CC} src/file/async_io.cc src/file/posix_file.cc)
 elseif(WIN32)
     message(SEND_ERROR "Windows is not supported")
     #set(SRC_CC ${SRC_CC} src/file/win_file.cc)
@@ -39,6 +39,15 @@ endforeach()
 add_library(moderndbs STATIC ${SRC_CC} ${INCLUDE_H})
 target_link_libraries(moderndbs gflags Threads::Threads)
 
+# libnuma is optional, see BufferManagerOptions::numa.
+find_library(NUMA_LIBRARY numa)
+find_path(NUMA_INCLUDE_DIR numa.h)
+if(NUMA_LIBRARY AND NUMA_INCLUDE_DIR)
+    target_compile_definitions(moderndbs PRIVATE MODERNDBS_HAVE_NUMA)
+    target_include_directories(moderndbs PRIVATE ${NUMA_INCLUDE_DIR})
+    target_link_libraries(moderndbs ${NUMA_LIBRARY})
+endif()
+
 # ---------------------------------------------------------------------------
 # Linting
 # ---------------------------------------------------------------------------
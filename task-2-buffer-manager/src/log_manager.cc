@@ -0,0 +1,315 @@
+#include "moderndbs/log_manager.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+
+namespace moderndbs {
+
+namespace {
+
+/// Returns the FNV-1a hash of a record, with its checksum counted as zero.
+uint32_t getChecksum(const char* record, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; ++i) {
+        bool isChecksum = i >= offsetof(LogRecord, checksum) && i < offsetof(LogRecord, checksum) + sizeof(uint32_t);
+        hash ^= isChecksum ? 0 : static_cast<uint8_t>(record[i]);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/// Calls `callback` for every complete record of `file` and returns the size
+/// of the valid part.
+size_t scanLog(File& file, const std::function<void(const LogRecord&)>& callback) {
+    size_t size = file.size();
+    if (size == 0) {
+        return 0;
+    }
+    // uint64_t keeps the records aligned.
+    std::vector<uint64_t> buffer((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    auto* data = reinterpret_cast<char*>(buffer.data());
+    file.read_block(0, size, data);
+    size_t offset = 0;
+    while (offset + sizeof(LogRecord) <= size) {
+        auto* record = reinterpret_cast<const LogRecord*>(data + offset);
+        if (record->size < sizeof(LogRecord) || record->size % sizeof(uint64_t) != 0 || record->size > size - offset
+            || sizeof(LogRecord) + 2 * static_cast<size_t>(record->length) > record->size
+            || getChecksum(data + offset, record->size) != record->checksum) {
+            break;
+        }
+        callback(*record);
+        offset += record->size;
+    }
+    return offset;
+}
+
+}  // namespace
+
+
+LogManager::LogManager(const char* filename, const LogManagerOptions& options)
+    : options(options), filename(filename), file(File::open_file(filename, File::WRITE, File::BUFFERED)) {
+    static std::atomic<uint64_t> nextManagerId{0};
+    managerId = nextManagerId.fetch_add(1, std::memory_order_relaxed);
+    uint64_t maxLsn = 0;
+    uint64_t maxTxn = 0;
+    fileSize = scanLog(*file, [&](const LogRecord& record) {
+        maxLsn = std::max(maxLsn, record.lsn);
+        maxTxn = std::max(maxTxn, record.txn);
+    });
+    // Cut off a torn record, new records must follow the valid ones.
+    file->resize(fileSize);
+    nextLsn.store(maxLsn + 1, std::memory_order_relaxed);
+    nextTxn.store(maxTxn + 1, std::memory_order_relaxed);
+    flushedLsn.store(maxLsn, std::memory_order_relaxed);
+    flusher = std::thread([this] { runFlusher(); });
+}
+
+LogManager::~LogManager() {
+    {
+        std::lock_guard<std::mutex> guard(flushMutex);
+        stopFlusher = true;
+    }
+    flusherWakeup.notify_one();
+    flusher.join();
+}
+
+LogManager::ThreadLog& LogManager::getThreadLog() {
+    thread_local std::vector<std::pair<uint64_t, ThreadLog*>> threadLogCache;
+    for (auto& [id, log] : threadLogCache) {
+        if (id == managerId) {
+            return *log;
+        }
+    }
+    auto log = std::make_unique<ThreadLog>(options.thread_buffer_size);
+    ThreadLog* result = log.get();
+    {
+        std::lock_guard<std::mutex> guard(threadLogsMutex);
+        threadLogs.push_back(std::move(log));
+    }
+    threadLogCache.emplace_back(managerId, result);
+    return *result;
+}
+
+uint64_t LogManager::append(ThreadLog& log) {
+    size_t size = log.scratch.size();
+    if (size > log.capacity) {
+        throw std::invalid_argument{"log record does not fit into the log buffer"};
+    }
+    // Announce the LSN before taking it, so the flusher never considers it
+    // durable before it is published.
+    log.pending.store(nextLsn.load());
+    uint64_t lsn = nextLsn.fetch_add(1);
+    auto* record = reinterpret_cast<LogRecord*>(log.scratch.data());
+    record->lsn = lsn;
+    record->checksum = getChecksum(log.scratch.data(), size);
+
+    uint64_t head = log.head.load(std::memory_order_relaxed);
+    while (log.capacity - (head - log.tail.load(std::memory_order_acquire)) < size) {
+        {
+            std::lock_guard<std::mutex> guard(flushMutex);
+            spaceWanted = true;
+        }
+        flusherWakeup.notify_one();
+        std::this_thread::yield();
+    }
+    size_t position = head % log.capacity;
+    size_t first = std::min(size, log.capacity - position);
+    std::memcpy(log.ring.get() + position, log.scratch.data(), first);
+    std::memcpy(log.ring.get(), log.scratch.data() + first, size - first);
+    log.head.store(head + size, std::memory_order_release);
+    log.pending.store(~0ull);
+    return lsn;
+}
+
+Transaction LogManager::begin() {
+    Transaction txn{nextTxn.fetch_add(1, std::memory_order_relaxed)};
+    std::lock_guard<std::mutex> guard(activeTxnsMutex);
+    activeTxns.emplace(txn.id, nextLsn.load());
+    return txn;
+}
+
+uint64_t LogManager::log_update(Transaction& txn, uint64_t page_id, char* page, uint32_t offset, const char* data, uint32_t length) {
+    return logPageWrite(LogRecord::UPDATE, txn, page_id, page, offset, data, length, 0);
+}
+
+uint64_t LogManager::log_compensation(Transaction& txn, uint64_t page_id, char* page, uint32_t offset, const char* data,
+    uint32_t length, uint64_t undo_next) {
+    return logPageWrite(LogRecord::COMPENSATION, txn, page_id, page, offset, data, length, undo_next);
+}
+
+uint64_t LogManager::logPageWrite(LogRecord::Type type, Transaction& txn, uint64_t page_id, char* page, uint32_t offset,
+    const char* data, uint32_t length, uint64_t undo_next) {
+    if (offset < page_header_size) {
+        throw std::invalid_argument{"updates must not overlap the page header"};
+    }
+    ThreadLog& log = getThreadLog();
+    size_t size = (sizeof(LogRecord) + 2 * static_cast<size_t>(length) + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t);
+    log.scratch.assign(size, 0);
+    auto* record = reinterpret_cast<LogRecord*>(log.scratch.data());
+    record->size = static_cast<uint32_t>(size);
+    record->txn = txn.id;
+    record->prev_lsn = txn.last_lsn;
+    record->page_id = page_id;
+    record->offset = offset;
+    record->length = length;
+    record->type = type;
+    record->undo_next = undo_next;
+    std::memcpy(log.scratch.data() + sizeof(LogRecord), page + offset, length);
+    std::memcpy(log.scratch.data() + sizeof(LogRecord) + length, data, length);
+    uint64_t lsn = append(log);
+    std::memcpy(page + offset, data, length);
+    set_page_lsn(page, lsn);
+    txn.last_lsn = lsn;
+    return lsn;
+}
+
+uint64_t LogManager::logTransactionEvent(LogRecord::Type type, uint64_t txn, uint64_t prev_lsn, uint64_t undo_next) {
+    ThreadLog& log = getThreadLog();
+    log.scratch.assign(sizeof(LogRecord), 0);
+    auto* record = reinterpret_cast<LogRecord*>(log.scratch.data());
+    record->size = sizeof(LogRecord);
+    record->txn = txn;
+    record->prev_lsn = prev_lsn;
+    record->type = type;
+    record->undo_next = undo_next;
+    return append(log);
+}
+
+void LogManager::commit(Transaction& txn) {
+    txn.last_lsn = logTransactionEvent(LogRecord::COMMIT, txn.id, txn.last_lsn, 0);
+    flush(txn.last_lsn);
+    // Only a durable commit ends the transaction for checkpoints.
+    std::lock_guard<std::mutex> guard(activeTxnsMutex);
+    activeTxns.erase(txn.id);
+}
+
+void LogManager::end(Transaction& txn) {
+    txn.last_lsn = logTransactionEvent(LogRecord::END, txn.id, txn.last_lsn, 0);
+    std::lock_guard<std::mutex> guard(activeTxnsMutex);
+    activeTxns.erase(txn.id);
+}
+
+uint64_t LogManager::get_min_active_lsn() {
+    uint64_t lsn = nextLsn.load();
+    std::lock_guard<std::mutex> guard(activeTxnsMutex);
+    for (auto& [id, beginLsn] : activeTxns) {
+        lsn = std::min(lsn, beginLsn);
+    }
+    return lsn;
+}
+
+uint64_t LogManager::log_checkpoint(uint64_t start_lsn) {
+    uint64_t lsn = logTransactionEvent(LogRecord::CHECKPOINT, 0, 0, start_lsn);
+    flush(lsn);
+    return lsn;
+}
+
+void LogManager::flush(uint64_t lsn) {
+    // Pages that were never logged may hold any LSN, waiting for it would
+    // never end.
+    lsn = std::min(lsn, nextLsn.load() - 1);
+    if (flushedLsn.load(std::memory_order_acquire) >= lsn) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(flushMutex);
+    flushRequest = std::max(flushRequest, lsn);
+    flusherWakeup.notify_one();
+    flushDone.wait(lock, [&] { return error || flushedLsn.load(std::memory_order_acquire) >= lsn; });
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void LogManager::runFlusher() {
+    std::unique_lock<std::mutex> lock(flushMutex);
+    while (!stopFlusher) {
+        auto isWanted = [&] { return stopFlusher || spaceWanted || flushRequest > flushedLsn.load(); };
+        flusherWakeup.wait_for(lock, options.flush_interval, isWanted);
+        if (options.commit_delay.count() > 0 && !stopFlusher && !spaceWanted && flushRequest > flushedLsn.load()) {
+            // Let further commits join this flush.
+            flusherWakeup.wait_for(lock, options.commit_delay, [&] { return stopFlusher || spaceWanted; });
+        }
+        spaceWanted = false;
+        lock.unlock();
+        flushRound();
+        lock.lock();
+    }
+    lock.unlock();
+    flushRound();
+}
+
+void LogManager::flushRound() {
+    // LSNs below the bound are published: their threads took them before
+    // the bound was read and announced them before. They also registered
+    // their logs before, so the bound is read before the logs are copied.
+    uint64_t bound = nextLsn.load();
+    std::vector<ThreadLog*> logs;
+    {
+        std::lock_guard<std::mutex> guard(threadLogsMutex);
+        for (auto& log : threadLogs) {
+            logs.push_back(log.get());
+        }
+    }
+    std::vector<char> buffer;
+    std::vector<uint64_t> heads;
+    for (ThreadLog* log : logs) {
+        bound = std::min(bound, log->pending.load());
+        uint64_t head = log->head.load(std::memory_order_acquire);
+        uint64_t tail = log->tail.load(std::memory_order_relaxed);
+        size_t position = tail % log->capacity;
+        size_t size = head - tail;
+        size_t first = std::min(size, log->capacity - position);
+        buffer.insert(buffer.end(), log->ring.get() + position, log->ring.get() + position + first);
+        buffer.insert(buffer.end(), log->ring.get(), log->ring.get() + (size - first));
+        heads.push_back(head);
+    }
+    bool failed;
+    {
+        std::lock_guard<std::mutex> guard(flushMutex);
+        failed = error != nullptr;
+    }
+    std::exception_ptr writeError;
+    if (!failed && (!buffer.empty() || bound - 1 > flushedLsn.load())) {
+        try {
+            if (!buffer.empty()) {
+                file->write_block(buffer.data(), fileSize, buffer.size());
+                fileSize += buffer.size();
+            }
+            file->sync();
+            flushCount.fetch_add(1, std::memory_order_relaxed);
+        } catch (...) {
+            writeError = std::current_exception();
+        }
+    }
+    // After a failure the records are dropped, so appends never block.
+    for (size_t i = 0; i < logs.size(); ++i) {
+        logs[i]->tail.store(heads[i], std::memory_order_release);
+    }
+    {
+        std::lock_guard<std::mutex> guard(flushMutex);
+        if (writeError) {
+            error = writeError;
+        } else if (!failed && bound - 1 > flushedLsn.load()) {
+            flushedLsn.store(bound - 1, std::memory_order_release);
+        }
+    }
+    flushDone.notify_all();
+}
+
+size_t LogManager::read(const char* filename, const std::function<void(const LogRecord&)>& callback) {
+    auto file = File::open_file(filename, File::READ);
+    return scanLog(*file, callback);
+}
+
+uint64_t LogManager::get_page_lsn(const char* page) {
+    uint64_t lsn;
+    std::memcpy(&lsn, page, sizeof(lsn));
+    return lsn;
+}
+
+void LogManager::set_page_lsn(char* page, uint64_t lsn) {
+    std::memcpy(page, &lsn, sizeof(lsn));
+}
+
+}  // namespace moderndbs
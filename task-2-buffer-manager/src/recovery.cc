@@ -0,0 +1,155 @@
+#include "moderndbs/recovery.h"
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+namespace moderndbs {
+
+uint64_t checkpoint(BufferManager& buffer_manager, LogManager& log) {
+    // Updates below the start were either applied before the flush or belong
+    // to a transaction that is still running and starts later.
+    uint64_t start = log.get_min_active_lsn();
+    buffer_manager.flush_all();
+    return log.log_checkpoint(start);
+}
+
+RecoveryStats recover(BufferManager& buffer_manager, LogManager& log, const RecoveryOptions& options) {
+    RecoveryStats stats;
+
+    // Analysis. Records of different threads are not ordered by LSN in the
+    // file, so the whole file is read and the records are sorted.
+    std::vector<uint64_t> storage;
+    std::vector<size_t> offsets;
+    LogManager::read(log.get_filename().c_str(), [&](const LogRecord& record) {
+        if (record.type == LogRecord::CHECKPOINT && record.undo_next > stats.start_lsn) {
+            stats.start_lsn = record.undo_next;
+        }
+        offsets.push_back(storage.size());
+        auto* words = reinterpret_cast<const uint64_t*>(&record);
+        storage.insert(storage.end(), words, words + record.size / sizeof(uint64_t));
+    });
+    std::vector<const LogRecord*> records;
+    for (size_t offset : offsets) {
+        auto* record = reinterpret_cast<const LogRecord*>(storage.data() + offset);
+        if (record->lsn >= stats.start_lsn) {
+            records.push_back(record);
+        }
+    }
+    std::sort(records.begin(), records.end(), [](const LogRecord* a, const LogRecord* b) { return a->lsn < b->lsn; });
+    stats.scanned = records.size();
+
+    // The last record of every transaction that did not finish.
+    std::unordered_map<uint64_t, uint64_t> losers;
+    std::unordered_map<uint64_t, const LogRecord*> byLsn;
+    for (auto* record : records) {
+        switch (record->type) {
+            case LogRecord::UPDATE:
+            case LogRecord::COMPENSATION:
+                losers[record->txn] = record->lsn;
+                byLsn.emplace(record->lsn, record);
+                break;
+            case LogRecord::COMMIT:
+            case LogRecord::END:
+                losers.erase(record->txn);
+                break;
+            case LogRecord::CHECKPOINT:
+                break;
+        }
+    }
+    stats.losers = losers.size();
+
+    // Redo, one partition of the pages per thread.
+    size_t threadCount = options.redo_threads;
+    if (threadCount == 0) {
+        threadCount = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+    std::vector<std::vector<const LogRecord*>> partitions(threadCount);
+    for (auto* record : records) {
+        if (record->type == LogRecord::UPDATE || record->type == LogRecord::COMPENSATION) {
+            partitions[record->page_id % threadCount].push_back(record);
+        }
+    }
+    std::vector<RecoveryStats> partitionStats(threadCount);
+    std::vector<std::exception_ptr> errors(threadCount);
+    auto redo = [&](size_t partition) {
+        try {
+            for (auto* record : partitions[partition]) {
+                auto& page = buffer_manager.fix_page(record->page_id, true);
+                char* data = page.get_data();
+                bool apply = LogManager::get_page_lsn(data) < record->lsn;
+                if (apply) {
+                    std::memcpy(data + record->offset, record->get_after(), record->length);
+                    LogManager::set_page_lsn(data, record->lsn);
+                    ++partitionStats[partition].redone;
+                } else {
+                    ++partitionStats[partition].skipped;
+                }
+                buffer_manager.unfix_page(page, apply);
+            }
+        } catch (...) {
+            errors[partition] = std::current_exception();
+        }
+    };
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threadCount; ++i) {
+        threads.emplace_back(redo, i);
+    }
+    redo(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (size_t i = 0; i < threadCount; ++i) {
+        if (errors[i]) {
+            std::rethrow_exception(errors[i]);
+        }
+        stats.redone += partitionStats[i].redone;
+        stats.skipped += partitionStats[i].skipped;
+    }
+
+    // Undo, the loser record with the highest LSN first.
+    std::priority_queue<std::pair<uint64_t, uint64_t>> pending;
+    std::unordered_map<uint64_t, Transaction> transactions;
+    for (auto& [txn, lastLsn] : losers) {
+        pending.emplace(lastLsn, txn);
+        transactions.emplace(txn, Transaction{txn, lastLsn});
+    }
+    while (!pending.empty()) {
+        auto [lsn, txnId] = pending.top();
+        pending.pop();
+        Transaction& txn = transactions.at(txnId);
+        auto it = byLsn.find(lsn);
+        if (it == byLsn.end()) {
+            throw std::runtime_error{"the log misses records of a loser transaction"};
+        }
+        const LogRecord* record = it->second;
+        uint64_t next;
+        if (record->type == LogRecord::UPDATE) {
+            auto& page = buffer_manager.fix_page(record->page_id, true);
+            log.log_compensation(txn, record->page_id, page.get_data(), record->offset, record->get_before(),
+                record->length, record->prev_lsn);
+            buffer_manager.unfix_page(page, true);
+            ++stats.undone;
+            next = record->prev_lsn;
+        } else {
+            // The updates after undo_next were undone before the crash.
+            next = record->undo_next;
+        }
+        if (next == 0) {
+            log.end(txn);
+        } else {
+            pending.emplace(next, txnId);
+        }
+    }
+
+    checkpoint(buffer_manager, log);
+    return stats;
+}
+
+}  // namespace moderndbs
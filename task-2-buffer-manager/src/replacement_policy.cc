@@ -0,0 +1,586 @@
+#include "moderndbs/replacement_policy.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "moderndbs/buffer_manager.h"
+
+
+namespace moderndbs {
+
+class TwoQPolicy
+: public ReplacementPolicy {
+private:
+    enum List : uint8_t { FIFO, LRU };
+
+    FrameList fifo;
+    FrameList lru;
+
+public:
+    void insert(BufferFrame* frame) override {
+        frame->policyList = FIFO;
+        fifo.push_back(frame);
+    }
+
+    bool access(BufferFrame* frame) override {
+        // A second access moves the page from the FIFO to the LRU list, later
+        // accesses put it at the end of the LRU list.
+        if (frame->policyList == LRU) {
+            lru.remove(frame);
+            lru.push_back(frame);
+            return false;
+        }
+        fifo.remove(frame);
+        frame->policyList = LRU;
+        lru.push_back(frame);
+        return true;
+    }
+
+    BufferFrame* evict(const std::function<bool(BufferFrame*)>& try_evict, uint64_t& promotions) override {
+        // Referenced frames only get a second chance in the first round, so
+        // concurrent optimistic readers cannot make the eviction fail.
+        for (bool second_chance : {true, false}) {
+            for (auto* list : {&fifo, &lru}) {
+                // Frames that get a second chance move to the end of the LRU
+                // list, so every frame is visited at most once per round.
+                size_t remaining = list->size();
+                BufferFrame* next = nullptr;
+                for (auto* victim = list->front(); victim != nullptr && remaining > 0; victim = next, --remaining) {
+                    next = victim->next;
+                    if (second_chance && victim->referenced.load(std::memory_order_relaxed)) {
+                        victim->referenced = false;
+                        promotions += access(victim);
+                        continue;
+                    }
+                    if (try_evict(victim)) {
+                        list->remove(victim);
+                        return victim;
+                    }
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    void remove(BufferFrame* frame) override {
+        (frame->policyList == LRU ? lru : fifo).remove(frame);
+    }
+
+    size_t size() const override {
+        return fifo.size() + lru.size();
+    }
+
+    void collect(size_t limit, std::vector<BufferFrame*>& frames) const override {
+        size_t begin = frames.size();
+        fifo.collect(limit, frames);
+        lru.collect(limit - (frames.size() - begin), frames);
+    }
+
+    std::vector<uint64_t> get_pages(bool repeated) const override {
+        std::vector<uint64_t> pages;
+        for (auto* frame = (repeated ? lru : fifo).front(); frame != nullptr; frame = frame->next) {
+            pages.push_back(frame->pageid);
+        }
+        return pages;
+    }
+};
+
+
+class ClockPolicy
+: public ReplacementPolicy {
+private:
+    /// The frames in clock order. The hand points to the next frame that is
+    /// considered for eviction, new frames are inserted right behind it.
+    FrameList ring;
+    BufferFrame* hand = nullptr;
+
+    BufferFrame* advance(BufferFrame* frame) const {
+        return frame->next != nullptr ? frame->next : ring.front();
+    }
+
+public:
+    void insert(BufferFrame* frame) override {
+        if (hand == nullptr) {
+            ring.push_back(frame);
+            hand = frame;
+        } else {
+            ring.insert_before(hand, frame);
+        }
+    }
+
+    bool access(BufferFrame* frame) override {
+        // Only write when necessary to keep the cache line shared.
+        if (!frame->referenced.load(std::memory_order_relaxed)) {
+            frame->referenced.store(true, std::memory_order_relaxed);
+        }
+        return false;
+    }
+
+    bool latch_free_access() const override {
+        return true;
+    }
+
+    BufferFrame* evict(const std::function<bool(BufferFrame*)>& try_evict, uint64_t&) override {
+        // The first turn clears all referenced bits, the second one finds an
+        // unused frame unless fixes set them again in the meantime, and the
+        // third one ignores them.
+        size_t turn = ring.size();
+        for (size_t step = 0; step < 3 * turn; ++step) {
+            BufferFrame* victim = hand;
+            hand = advance(victim);
+            if (step < 2 * turn && victim->referenced.load(std::memory_order_relaxed)) {
+                victim->referenced.store(false, std::memory_order_relaxed);
+                continue;
+            }
+            if (try_evict(victim)) {
+                ring.remove(victim);
+                if (ring.size() == 0) {
+                    hand = nullptr;
+                }
+                return victim;
+            }
+        }
+        return nullptr;
+    }
+
+    void remove(BufferFrame* frame) override {
+        if (hand == frame) {
+            hand = advance(frame);
+        }
+        ring.remove(frame);
+        if (ring.size() == 0) {
+            hand = nullptr;
+        }
+    }
+
+    size_t size() const override {
+        return ring.size();
+    }
+
+    void collect(size_t limit, std::vector<BufferFrame*>& frames) const override {
+        auto* frame = hand;
+        for (size_t i = 0; i < std::min(limit, ring.size()); ++i, frame = advance(frame)) {
+            frames.push_back(frame);
+        }
+    }
+
+    std::vector<uint64_t> get_pages(bool repeated) const override {
+        std::vector<uint64_t> pages;
+        if (!repeated) {
+            std::vector<BufferFrame*> frames;
+            collect(ring.size(), frames);
+            for (auto* frame : frames) {
+                pages.push_back(frame->pageid);
+            }
+        }
+        return pages;
+    }
+};
+
+
+class LruKPolicy
+: public ReplacementPolicy {
+private:
+    enum List : uint8_t { ONCE, HEAP };
+
+    /// Pages accessed once in FIFO order, and a min-heap of the pages accessed
+    /// repeatedly by the logical time of their second to last access.
+    FrameList once;
+    std::vector<BufferFrame*> heap;
+    /// Frames set aside during an eviction.
+    std::vector<BufferFrame*> rejected;
+    uint64_t clock = 0;
+
+    static uint64_t key(const BufferFrame* frame) {
+        return frame->policyHistory[1];
+    }
+
+    void place(size_t index, BufferFrame* frame) {
+        heap[index] = frame;
+        frame->policyIndex = index;
+    }
+
+    void siftUp(size_t index) {
+        BufferFrame* frame = heap[index];
+        while (index > 0 && key(heap[(index - 1) / 2]) > key(frame)) {
+            place(index, heap[(index - 1) / 2]);
+            index = (index - 1) / 2;
+        }
+        place(index, frame);
+    }
+
+    void siftDown(size_t index) {
+        BufferFrame* frame = heap[index];
+        while (2 * index + 1 < heap.size()) {
+            size_t child = 2 * index + 1;
+            if (child + 1 < heap.size() && key(heap[child + 1]) < key(heap[child])) {
+                ++child;
+            }
+            if (key(frame) <= key(heap[child])) {
+                break;
+            }
+            place(index, heap[child]);
+            index = child;
+        }
+        place(index, frame);
+    }
+
+    void heapPush(BufferFrame* frame) {
+        heap.push_back(frame);
+        siftUp(heap.size() - 1);
+    }
+
+    BufferFrame* heapPop() {
+        BufferFrame* top = heap.front();
+        BufferFrame* last = heap.back();
+        heap.pop_back();
+        if (!heap.empty()) {
+            place(0, last);
+            siftDown(0);
+        }
+        return top;
+    }
+
+    void touch(BufferFrame* frame) {
+        frame->policyHistory[1] = frame->policyHistory[0];
+        frame->policyHistory[0] = ++clock;
+    }
+
+    std::vector<BufferFrame*> sortedHeap() const {
+        auto frames = heap;
+        std::sort(frames.begin(), frames.end(), [](auto* a, auto* b) { return key(a) < key(b); });
+        return frames;
+    }
+
+public:
+    explicit LruKPolicy(size_t capacity) {
+        heap.reserve(capacity);
+        rejected.reserve(capacity);
+    }
+
+    void insert(BufferFrame* frame) override {
+        frame->policyList = ONCE;
+        frame->policyHistory[0] = ++clock;
+        frame->policyHistory[1] = 0;
+        once.push_back(frame);
+    }
+
+    bool access(BufferFrame* frame) override {
+        touch(frame);
+        if (frame->policyList == HEAP) {
+            // The key only grows.
+            siftDown(frame->policyIndex);
+            return false;
+        }
+        once.remove(frame);
+        frame->policyList = HEAP;
+        heapPush(frame);
+        return true;
+    }
+
+    BufferFrame* evict(const std::function<bool(BufferFrame*)>& try_evict, uint64_t& promotions) override {
+        for (bool second_chance : {true, false}) {
+            // Pages accessed once have an infinite backward distance and go
+            // first, in FIFO order.
+            size_t remaining = once.size();
+            BufferFrame* next = nullptr;
+            for (auto* victim = once.front(); victim != nullptr && remaining > 0; victim = next, --remaining) {
+                next = victim->next;
+                if (second_chance && victim->referenced.load(std::memory_order_relaxed)) {
+                    victim->referenced = false;
+                    promotions += access(victim);
+                    continue;
+                }
+                if (try_evict(victim)) {
+                    once.remove(victim);
+                    return victim;
+                }
+            }
+            // Then the page whose second to last access is the oldest. Rejected
+            // frames are set aside, so each one is considered once.
+            BufferFrame* victim = nullptr;
+            while (victim == nullptr && !heap.empty()) {
+                BufferFrame* candidate = heapPop();
+                if (second_chance && candidate->referenced.load(std::memory_order_relaxed)) {
+                    candidate->referenced = false;
+                    touch(candidate);
+                    rejected.push_back(candidate);
+                } else if (try_evict(candidate)) {
+                    victim = candidate;
+                } else {
+                    rejected.push_back(candidate);
+                }
+            }
+            for (auto* frame : rejected) {
+                heapPush(frame);
+            }
+            rejected.clear();
+            if (victim != nullptr) {
+                return victim;
+            }
+        }
+        return nullptr;
+    }
+
+    void remove(BufferFrame* frame) override {
+        if (frame->policyList == ONCE) {
+            once.remove(frame);
+            return;
+        }
+        // The last frame takes the place of the removed one and moves in
+        // whichever direction its key requires.
+        BufferFrame* last = heap.back();
+        heap.pop_back();
+        if (last != frame) {
+            place(frame->policyIndex, last);
+            siftUp(last->policyIndex);
+            siftDown(last->policyIndex);
+        }
+    }
+
+    size_t size() const override {
+        return once.size() + heap.size();
+    }
+
+    void collect(size_t limit, std::vector<BufferFrame*>& frames) const override {
+        size_t begin = frames.size();
+        once.collect(limit, frames);
+        for (auto* frame : sortedHeap()) {
+            if (frames.size() - begin >= limit) {
+                break;
+            }
+            frames.push_back(frame);
+        }
+    }
+
+    std::vector<uint64_t> get_pages(bool repeated) const override {
+        std::vector<uint64_t> pages;
+        if (repeated) {
+            for (auto* frame : sortedHeap()) {
+                pages.push_back(frame->pageid);
+            }
+        } else {
+            for (auto* frame = once.front(); frame != nullptr; frame = frame->next) {
+                pages.push_back(frame->pageid);
+            }
+        }
+        return pages;
+    }
+};
+
+
+class ArcPolicy
+: public ReplacementPolicy {
+private:
+    enum List : uint8_t { T1, T2 };
+
+    static constexpr uint32_t none = UINT32_MAX;
+
+    /// A page recently evicted from `t1` or `t2`, linked into its ghost list
+    /// and into a bucket of the ghost table.
+    struct Ghost {
+        uint64_t pageid = 0;
+        uint32_t prev = none;
+        uint32_t next = none;
+        uint32_t hashNext = none;
+        bool inB2 = false;
+    };
+
+    /// A list of ghosts, oldest first.
+    struct GhostList {
+        uint32_t head = none;
+        uint32_t tail = none;
+        size_t length = 0;
+    };
+
+    size_t capacity;
+    /// Target size of `t1`, adapted on every hit in the ghost lists.
+    size_t target = 0;
+    /// Resident pages accessed once and repeatedly, in LRU order.
+    FrameList t1;
+    FrameList t2;
+    /// Ids of pages recently evicted from `t1` and `t2`. The directory never
+    /// holds more than twice the capacity, so all ghosts and the buckets of
+    /// the ghost table are allocated up front and misses do not allocate.
+    GhostList b1;
+    GhostList b2;
+    std::vector<Ghost> ghosts;
+    std::vector<uint32_t> buckets;
+    unsigned bucketShift;
+    /// Unused ghosts, linked through `next`.
+    uint32_t freeGhosts = none;
+
+    size_t getBucket(uint64_t pageid) const {
+        return (pageid * 0x9E3779B97F4A7C15ull) >> bucketShift;
+    }
+
+    uint32_t findGhost(uint64_t pageid) const {
+        uint32_t index = buckets[getBucket(pageid)];
+        while (index != none && ghosts[index].pageid != pageid) {
+            index = ghosts[index].hashNext;
+        }
+        return index;
+    }
+
+    /// Appends a ghost for `pageid` to `b1` or `b2`.
+    void addGhost(uint64_t pageid, bool inB2) {
+        if (freeGhosts == none) {
+            // Only reached when the directory is full, which `trim` prevents.
+            forget(b1.length > 0 ? b1 : b2);
+        }
+        uint32_t index = freeGhosts;
+        Ghost& ghost = ghosts[index];
+        freeGhosts = ghost.next;
+        ghost.pageid = pageid;
+        ghost.inB2 = inB2;
+        size_t bucket = getBucket(pageid);
+        ghost.hashNext = buckets[bucket];
+        buckets[bucket] = index;
+        GhostList& list = inB2 ? b2 : b1;
+        ghost.prev = list.tail;
+        ghost.next = none;
+        (list.tail == none ? list.head : ghosts[list.tail].next) = index;
+        list.tail = index;
+        ++list.length;
+    }
+
+    /// Unlinks the ghost at `index` from its list and the table and frees it.
+    void removeGhost(uint32_t index) {
+        Ghost& ghost = ghosts[index];
+        GhostList& list = ghost.inB2 ? b2 : b1;
+        (ghost.prev == none ? list.head : ghosts[ghost.prev].next) = ghost.next;
+        (ghost.next == none ? list.tail : ghosts[ghost.next].prev) = ghost.prev;
+        --list.length;
+        uint32_t* link = &buckets[getBucket(ghost.pageid)];
+        while (*link != index) {
+            link = &ghosts[*link].hashNext;
+        }
+        *link = ghost.hashNext;
+        ghost.next = freeGhosts;
+        freeGhosts = index;
+    }
+
+    void forget(GhostList& ghostList) {
+        removeGhost(ghostList.head);
+    }
+
+    /// Keeps the directory at most twice the size of the cache, and `t1` with
+    /// `b1` at most the size of the cache.
+    void trim() {
+        while (t1.size() + b1.length > capacity && b1.length > 0) {
+            forget(b1);
+        }
+        while (t1.size() + t2.size() + b1.length + b2.length > 2 * capacity && b2.length > 0) {
+            forget(b2);
+        }
+    }
+
+public:
+    explicit ArcPolicy(size_t capacity) : capacity(capacity), ghosts(std::max<size_t>(2 * capacity, 1)) {
+        // At least one bucket per ghost, rounded up to a power of two.
+        unsigned bits = 0;
+        while ((size_t{1} << bits) < ghosts.size()) {
+            bits++;
+        }
+        bucketShift = 64 - bits;
+        buckets.assign(size_t{1} << bits, none);
+        for (uint32_t i = ghosts.size(); i-- > 0;) {
+            ghosts[i].next = freeGhosts;
+            freeGhosts = i;
+        }
+    }
+
+    void insert(BufferFrame* frame) override {
+        uint32_t ghost = findGhost(frame->pageid);
+        if (ghost == none) {
+            frame->policyList = T1;
+            t1.push_back(frame);
+            trim();
+            return;
+        }
+        // The page was evicted too early, grow the list it was evicted from.
+        if (ghosts[ghost].inB2) {
+            target -= std::min(target, std::max<size_t>(b1.length / b2.length, 1));
+        } else {
+            target = std::min(capacity, target + std::max<size_t>(b2.length / b1.length, 1));
+        }
+        removeGhost(ghost);
+        frame->policyList = T2;
+        t2.push_back(frame);
+    }
+
+    bool access(BufferFrame* frame) override {
+        bool promoted = frame->policyList == T1;
+        (promoted ? t1 : t2).remove(frame);
+        frame->policyList = T2;
+        t2.push_back(frame);
+        return promoted;
+    }
+
+    BufferFrame* evict(const std::function<bool(BufferFrame*)>& try_evict, uint64_t& promotions) override {
+        for (bool second_chance : {true, false}) {
+            // Evict from the recency list while it exceeds its target size.
+            bool t1First = t1.size() > target || t2.size() == 0;
+            for (auto* list : {t1First ? &t1 : &t2, t1First ? &t2 : &t1}) {
+                // Frames that get a second chance move to the end of `t2`, so
+                // every frame is visited at most once per round.
+                size_t remaining = list->size();
+                BufferFrame* next = nullptr;
+                for (auto* victim = list->front(); victim != nullptr && remaining > 0; victim = next, --remaining) {
+                    next = victim->next;
+                    if (second_chance && victim->referenced.load(std::memory_order_relaxed)) {
+                        victim->referenced = false;
+                        promotions += access(victim);
+                        continue;
+                    }
+                    if (try_evict(victim)) {
+                        list->remove(victim);
+                        addGhost(victim->pageid, list == &t2);
+                        trim();
+                        return victim;
+                    }
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    void remove(BufferFrame* frame) override {
+        // The page was not evicted, so it is not remembered as a ghost.
+        (frame->policyList == T1 ? t1 : t2).remove(frame);
+    }
+
+    size_t size() const override {
+        return t1.size() + t2.size();
+    }
+
+    void collect(size_t limit, std::vector<BufferFrame*>& frames) const override {
+        size_t begin = frames.size();
+        t1.collect(limit, frames);
+        t2.collect(limit - (frames.size() - begin), frames);
+    }
+
+    std::vector<uint64_t> get_pages(bool repeated) const override {
+        std::vector<uint64_t> pages;
+        for (auto* frame = (repeated ? t2 : t1).front(); frame != nullptr; frame = frame->next) {
+            pages.push_back(frame->pageid);
+        }
+        return pages;
+    }
+};
+
+
+std::unique_ptr<ReplacementPolicy> ReplacementPolicy::make(Kind kind, size_t capacity) {
+    switch (kind) {
+        case CLOCK:
+            return std::make_unique<ClockPolicy>();
+        case LRU_K:
+            return std::make_unique<LruKPolicy>(capacity);
+        case ARC:
+            return std::make_unique<ArcPolicy>(capacity);
+        case TWO_Q:
+            break;
+    }
+    return std::make_unique<TwoQPolicy>();
+}
+
+}  // namespace moderndbs
@@ -0,0 +1,166 @@
+#include "moderndbs/trace_recorder.h"
+#include <algorithm>
+#include <unordered_map>
+#include "moderndbs/buffer_manager.h"
+
+
+namespace moderndbs {
+
+namespace {
+
+/// Returns the number of the calling thread in traces.
+uint32_t getThreadNumber() {
+    static std::atomic<uint32_t> nextThread{0};
+    thread_local uint32_t thread = nextThread.fetch_add(1, std::memory_order_relaxed);
+    return thread;
+}
+
+}  // namespace
+
+
+TraceRecorder::TraceRecorder(const char* filename, size_t chunk_records, size_t chunk_count)
+    : file(File::open_file(filename, File::WRITE, File::BUFFERED)), chunkRecords(std::max<size_t>(chunk_records, 1)),
+      chunkCount(std::max<size_t>(chunk_count, 1)), chunks(std::make_unique<Chunk[]>(chunkCount)),
+      start(std::chrono::steady_clock::now()) {
+    file->resize(0);
+    for (size_t i = 0; i < chunkCount; ++i) {
+        chunks[i].records = std::make_unique<TraceRecord[]>(chunkRecords);
+        chunks[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    writer = std::thread([this] { runWriter(); });
+}
+
+TraceRecorder::~TraceRecorder() {
+    {
+        std::lock_guard<std::mutex> guard(writerMutex);
+        stopWriter = true;
+    }
+    writerWakeup.notify_one();
+    writer.join();
+}
+
+void TraceRecorder::record(TraceRecord::Event event, uint64_t page_id, TraceRecord::Mode mode, bool dirty) {
+    if (failed.load(std::memory_order_relaxed)) {
+        return;
+    }
+    auto timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    uint64_t index = position.fetch_add(1, std::memory_order_relaxed);
+    uint64_t sequence = index / chunkRecords;
+    Chunk& chunk = chunks[sequence % chunkCount];
+    // The ring is full until the writer wrote the previous round of the
+    // chunk.
+    while (chunk.sequence.load(std::memory_order_acquire) != sequence) {
+        std::this_thread::yield();
+    }
+    chunk.records[index % chunkRecords] = TraceRecord{
+        page_id, static_cast<uint64_t>(timestamp.count()), getThreadNumber(), event, mode, dirty, 0
+    };
+    if (chunk.filled.fetch_add(1, std::memory_order_acq_rel) + 1 == chunkRecords) {
+        std::lock_guard<std::mutex> guard(writerMutex);
+        writerWakeup.notify_one();
+    }
+}
+
+void TraceRecorder::runWriter() {
+    uint64_t sequence = 0;
+    std::unique_lock<std::mutex> lock(writerMutex);
+    while (true) {
+        Chunk& chunk = chunks[sequence % chunkCount];
+        if (chunk.filled.load(std::memory_order_acquire) == chunkRecords) {
+            lock.unlock();
+            writeChunk(sequence, chunkRecords);
+            lock.lock();
+            ++sequence;
+            continue;
+        }
+        if (stopWriter) {
+            break;
+        }
+        writerWakeup.wait(lock, [&] { return stopWriter || chunk.filled.load(std::memory_order_acquire) == chunkRecords; });
+    }
+    // No record() runs anymore, so the last chunk is complete up to the
+    // position.
+    size_t remaining = position.load(std::memory_order_relaxed) - sequence * chunkRecords;
+    if (remaining > 0) {
+        writeChunk(sequence, remaining);
+    }
+}
+
+void TraceRecorder::writeChunk(uint64_t sequence, size_t count) {
+    Chunk& chunk = chunks[sequence % chunkCount];
+    if (!failed.load(std::memory_order_relaxed)) {
+        try {
+            file->write_block(
+                reinterpret_cast<const char*>(chunk.records.get()),
+                sequence * chunkRecords * sizeof(TraceRecord),
+                count * sizeof(TraceRecord)
+            );
+        } catch (...) {
+            failed.store(true, std::memory_order_relaxed);
+        }
+    }
+    chunk.filled.store(0, std::memory_order_relaxed);
+    chunk.sequence.store(sequence + chunkCount, std::memory_order_release);
+}
+
+std::vector<TraceRecord> TraceRecorder::read(const char* filename) {
+    auto file = File::open_file(filename, File::READ);
+    std::vector<TraceRecord> trace(file->size() / sizeof(TraceRecord));
+    file->read_block(0, trace.size() * sizeof(TraceRecord), reinterpret_cast<char*>(trace.data()));
+    return trace;
+}
+
+
+BufferManagerStats replay_trace(const std::vector<TraceRecord>& trace, size_t page_count, ReplacementPolicy::Kind kind) {
+    BufferManagerStats stats;
+    auto frames = std::make_unique<BufferFrame[]>(page_count);
+    std::vector<BufferFrame*> freeFrames;
+    for (size_t i = page_count; i > 0; --i) {
+        freeFrames.push_back(&frames[i - 1]);
+    }
+    auto policy = ReplacementPolicy::make(kind, page_count);
+    std::unordered_map<uint64_t, BufferFrame*> resident;
+    std::unordered_map<uint64_t, uint32_t> fixCounts;
+    auto unfixed = [&](BufferFrame* victim) { return fixCounts.count(victim->pageid) == 0; };
+
+    for (auto& record : trace) {
+        if (record.event == TraceRecord::UNFIX) {
+            // The fix may precede the trace.
+            auto it = fixCounts.find(record.page_id);
+            if (it != fixCounts.end() && --it->second == 0) {
+                fixCounts.erase(it);
+            }
+            continue;
+        }
+        if (record.mode != TraceRecord::OPTIMISTIC) {
+            ++fixCounts[record.page_id];
+        }
+        auto it = resident.find(record.page_id);
+        if (it != resident.end()) {
+            ++stats.hits;
+            if (policy->access(it->second)) {
+                ++stats.promotions;
+            }
+            continue;
+        }
+        ++stats.misses;
+        BufferFrame* frame;
+        if (!freeFrames.empty()) {
+            frame = freeFrames.back();
+            freeFrames.pop_back();
+        } else {
+            frame = policy->evict(unfixed, stats.promotions);
+            if (frame == nullptr) {
+                continue;
+            }
+            resident.erase(frame->pageid);
+            ++stats.evictions;
+        }
+        frame->pageid = record.page_id;
+        resident.emplace(record.page_id, frame);
+        policy->insert(frame);
+    }
+    return stats;
+}
+
+}  // namespace moderndbs
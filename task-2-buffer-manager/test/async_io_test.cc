@@ -0,0 +1,202 @@
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <system_error>
+#include <vector>
+#include <gtest/gtest.h>
+#include "moderndbs/async_io.h"
+#include "moderndbs/file.h"
+
+
+namespace {
+
+void checkBatchRoundTrip(moderndbs::AsyncIO& io) {
+    auto file = moderndbs::File::make_temporary_file();
+    constexpr size_t block_count = 64;
+    constexpr size_t block_size = 4096;
+    std::vector<char> blocks(block_count * block_size);
+    for (size_t i = 0; i < block_count; ++i) {
+        std::memset(&blocks[i * block_size], static_cast<int>(i), block_size);
+    }
+    std::vector<moderndbs::IORequest> requests(block_count);
+    std::vector<moderndbs::IORequest*> batch;
+    for (size_t i = 0; i < block_count; ++i) {
+        requests[i].kind = moderndbs::IORequest::WRITE;
+        requests[i].file = file.get();
+        requests[i].offset = i * block_size;
+        requests[i].size = block_size;
+        requests[i].block = &blocks[i * block_size];
+        batch.push_back(&requests[i]);
+    }
+    io.submit(batch.data(), batch.size());
+    for (auto& request : requests) {
+        io.wait(request);
+    }
+
+    std::vector<char> read_blocks(block_count * block_size);
+    std::vector<moderndbs::IORequest> reads(block_count);
+    batch.clear();
+    for (size_t i = 0; i < block_count; ++i) {
+        reads[i].kind = moderndbs::IORequest::READ;
+        reads[i].file = file.get();
+        reads[i].offset = i * block_size;
+        reads[i].size = block_size;
+        reads[i].block = &read_blocks[i * block_size];
+        batch.push_back(&reads[i]);
+    }
+    io.submit(batch.data(), batch.size());
+    for (auto& request : reads) {
+        io.wait(request);
+    }
+    EXPECT_EQ(blocks, read_blocks);
+}
+
+
+void checkLinkedWriteRead(moderndbs::AsyncIO& io) {
+    auto file = moderndbs::File::make_temporary_file();
+    std::vector<char> block(1024, 'a');
+    moderndbs::IORequest write;
+    write.kind = moderndbs::IORequest::WRITE;
+    write.file = file.get();
+    write.size = block.size();
+    write.block = block.data();
+    write.link_next = true;
+    // The read goes into the buffer that is written, so it must only start
+    // after the write completed.
+    moderndbs::IORequest read;
+    read.kind = moderndbs::IORequest::READ;
+    read.file = file.get();
+    read.offset = 0;
+    read.size = block.size();
+    read.block = block.data();
+    moderndbs::IORequest* batch[] = {&write, &read};
+    io.submit(batch, 2);
+    io.wait(write);
+    io.wait(read);
+    EXPECT_EQ(std::vector<char>(1024, 'a'), block);
+}
+
+
+void checkFailedLink(moderndbs::AsyncIO& io) {
+    auto file = moderndbs::File::make_temporary_file();
+    std::vector<char> block(1024);
+    moderndbs::IORequest write;
+    write.kind = moderndbs::IORequest::WRITE;
+    write.file = file.get();
+    // Larger than any file system allows.
+    write.offset = size_t{1} << 62;
+    write.size = block.size();
+    write.block = block.data();
+    write.link_next = true;
+    moderndbs::IORequest read;
+    read.kind = moderndbs::IORequest::READ;
+    read.file = file.get();
+    read.size = block.size();
+    read.block = block.data();
+    moderndbs::IORequest* batch[] = {&write, &read};
+    io.submit(batch, 2);
+    EXPECT_THROW(io.wait(write), std::system_error);
+    EXPECT_THROW(io.wait(read), std::system_error);
+    EXPECT_EQ(ECANCELED, read.error);
+}
+
+
+void checkVectoredRoundTrip(moderndbs::AsyncIO& io) {
+    auto file = moderndbs::File::make_temporary_file();
+    // The blocks are written in reverse memory order to adjacent file blocks.
+    std::vector<char> memory(3 * 1024);
+    for (size_t i = 0; i < 3; ++i) {
+        std::memset(&memory[(2 - i) * 1024], 'a' + static_cast<int>(i), 1024);
+    }
+    moderndbs::File::Block blocks[] = {{&memory[2048], 1024}, {&memory[1024], 1024}, {&memory[0], 1024}};
+    moderndbs::IORequest write;
+    write.kind = moderndbs::IORequest::WRITE;
+    write.file = file.get();
+    write.offset = 1024;
+    write.size = 3 * 1024;
+    write.blocks = blocks;
+    write.block_count = 3;
+    io.submit(write);
+    io.wait(write);
+
+    std::vector<char> contents(4 * 1024);
+    file->read_block(0, contents.size(), contents.data());
+    for (size_t i = 0; i < 3; ++i) {
+        EXPECT_EQ(std::vector<char>(1024, static_cast<char>('a' + i)),
+            std::vector<char>(&contents[(i + 1) * 1024], &contents[(i + 2) * 1024]));
+    }
+
+    // Scattered into blocks of different sizes.
+    std::vector<char> first(1024 + 512);
+    std::vector<char> second(512);
+    moderndbs::File::Block read_blocks[] = {{first.data(), first.size()}, {second.data(), second.size()}};
+    moderndbs::IORequest read;
+    read.kind = moderndbs::IORequest::READ;
+    read.file = file.get();
+    read.offset = 2048;
+    read.size = 2048;
+    read.blocks = read_blocks;
+    read.block_count = 2;
+    io.submit(read);
+    io.wait(read);
+    EXPECT_EQ(std::vector<char>(&contents[2048], &contents[2048 + first.size()]), first);
+    EXPECT_EQ(std::vector<char>(512, 'c'), second);
+}
+
+
+// NOLINTNEXTLINE
+TEST(AsyncIOTest, BatchRoundTrip) {
+    auto io = moderndbs::AsyncIO::make(16);
+    checkBatchRoundTrip(*io);
+}
+
+
+// NOLINTNEXTLINE
+TEST(AsyncIOTest, ThreadPoolBatchRoundTrip) {
+    auto io = moderndbs::AsyncIO::make_thread_pool(4);
+    checkBatchRoundTrip(*io);
+}
+
+
+// NOLINTNEXTLINE
+TEST(AsyncIOTest, VectoredRoundTrip) {
+    auto io = moderndbs::AsyncIO::make(16);
+    checkVectoredRoundTrip(*io);
+}
+
+
+// NOLINTNEXTLINE
+TEST(AsyncIOTest, ThreadPoolVectoredRoundTrip) {
+    auto io = moderndbs::AsyncIO::make_thread_pool(4);
+    checkVectoredRoundTrip(*io);
+}
+
+
+// NOLINTNEXTLINE
+TEST(AsyncIOTest, LinkedWriteRead) {
+    auto io = moderndbs::AsyncIO::make(16);
+    checkLinkedWriteRead(*io);
+}
+
+
+// NOLINTNEXTLINE
+TEST(AsyncIOTest, ThreadPoolLinkedWriteRead) {
+    auto io = moderndbs::AsyncIO::make_thread_pool(4);
+    checkLinkedWriteRead(*io);
+}
+
+
+// NOLINTNEXTLINE
+TEST(AsyncIOTest, FailedLink) {
+    auto io = moderndbs::AsyncIO::make(16);
+    checkFailedLink(*io);
+}
+
+
+// NOLINTNEXTLINE
+TEST(AsyncIOTest, ThreadPoolFailedLink) {
+    auto io = moderndbs::AsyncIO::make_thread_pool(4);
+    checkFailedLink(*io);
+}
+
+}  // namespace
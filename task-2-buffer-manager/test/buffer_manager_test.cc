@@ -1,8 +1,14 @@
 #include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <cstdio>
 #include <cstring>
 #include <memory>
+#include <new>
 #include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
 #include <thread>
 #include <vector>
 #include <gtest/gtest.h>
@@ -62,6 +68,33 @@ TEST(BufferManagerTest, PersistentRestart) {
 }
 
 
+// NOLINTNEXTLINE
+TEST(BufferManagerTest, PersistentRestartIOModes) {
+    uint64_t segment_shift = static_cast<uint64_t>(9) << 48;
+    for (auto io_mode : {moderndbs::File::BUFFERED, moderndbs::File::DIRECT}) {
+        moderndbs::BufferManagerOptions options;
+        options.io_mode = io_mode;
+        auto buffer_manager = std::make_unique<moderndbs::BufferManager>(4096, 4, options);
+        for (uint64_t segment_page = 0; segment_page < 10; ++segment_page) {
+            auto& page = buffer_manager->fix_page(segment_shift | segment_page, true);
+            uint64_t& value = *reinterpret_cast<uint64_t*>(page.get_data());
+            value = segment_page + io_mode;
+            buffer_manager->unfix_page(page, true);
+        }
+        buffer_manager = std::make_unique<moderndbs::BufferManager>(4096, 4, options);
+        for (uint64_t segment_page = 0; segment_page < 10; ++segment_page) {
+            auto& page = buffer_manager->fix_page(segment_shift | segment_page, false);
+            uint64_t value = *reinterpret_cast<uint64_t*>(page.get_data());
+            buffer_manager->unfix_page(page, false);
+            EXPECT_EQ(segment_page + io_mode, value);
+        }
+    }
+    moderndbs::BufferManagerOptions options;
+    options.io_mode = moderndbs::File::DIRECT;
+    EXPECT_THROW(moderndbs::BufferManager(1024, 4, options), std::invalid_argument);
+}
+
+
 // NOLINTNEXTLINE
 TEST(BufferManagerTest, FIFOEvict) {
     moderndbs::BufferManager buffer_manager{1024, 10};
@@ -102,6 +135,39 @@ TEST(BufferManagerTest, BufferFull) {
 }
 
 
+// NOLINTNEXTLINE
+TEST(BufferManagerTest, BufferFullWait) {
+    moderndbs::BufferManagerOptions options;
+    options.buffer_full_timeout = std::chrono::milliseconds{10};
+    moderndbs::BufferManager buffer_manager{1024, 1, options};
+    auto& page = buffer_manager.fix_page(1, false);
+    EXPECT_THROW(buffer_manager.fix_page(2, false), moderndbs::buffer_full_error);
+    EXPECT_EQ(1, buffer_manager.get_stats().full_waits);
+    EXPECT_GE(buffer_manager.get_stats().full_wait_ns, 10000000);
+
+    // The fix waits for the page to be unfixed instead of failing.
+    options.buffer_full_timeout = std::chrono::seconds{10};
+    moderndbs::BufferManager waiting_buffer_manager{1024, 1, options};
+    std::atomic<bool> fixed{false};
+    std::thread unfix_thread{[&] {
+        auto& waiting_page = waiting_buffer_manager.fix_page(1, false);
+        fixed = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds{1});
+        waiting_buffer_manager.unfix_page(waiting_page, false);
+    }};
+    while (!fixed) {
+        std::this_thread::yield();
+    }
+    auto& other_page = waiting_buffer_manager.fix_page(2, false);
+    unfix_thread.join();
+    waiting_buffer_manager.unfix_page(other_page, false);
+    EXPECT_EQ(std::vector<uint64_t>{2}, waiting_buffer_manager.get_fifo_list());
+    EXPECT_EQ(1, waiting_buffer_manager.get_stats().full_waits);
+    EXPECT_EQ(0, waiting_buffer_manager.get_stats().buffer_full_errors);
+    buffer_manager.unfix_page(page, false);
+}
+
+
 // NOLINTNEXTLINE
 TEST(BufferManagerTest, MoveToLRU) {
     moderndbs::BufferManager buffer_manager{1024, 10};
@@ -138,6 +204,579 @@ TEST(BufferManagerTest, LRURefresh) {
 }
 
 
+// NOLINTNEXTLINE
+TEST(BufferManagerTest, Stats) {
+    moderndbs::BufferManager buffer_manager{1024, 2};
+    uint64_t segment_shift = static_cast<uint64_t>(14) << 48;
+    {
+        auto& page = buffer_manager.fix_page(segment_shift | 1, true);
+        buffer_manager.unfix_page(page, true);
+    }
+    buffer_manager.unfix_page(buffer_manager.fix_page(segment_shift | 1, false), false);
+    buffer_manager.unfix_page(buffer_manager.fix_page(segment_shift | 2, false), false);
+    // Evicts page 2, then page 1 which is written back.
+    auto& page3 = buffer_manager.fix_page(segment_shift | 3, false);
+    auto& page4 = buffer_manager.fix_page(segment_shift | 4, false);
+    EXPECT_THROW(buffer_manager.fix_page(segment_shift | 5, false), moderndbs::buffer_full_error);
+    buffer_manager.unfix_page(page4, false);
+    buffer_manager.unfix_page(page3, false);
+
+    auto stats = buffer_manager.get_stats();
+    EXPECT_EQ(1, stats.hits);
+    EXPECT_EQ(5, stats.misses);
+    EXPECT_EQ(1, stats.promotions);
+    EXPECT_EQ(2, stats.evictions);
+    EXPECT_EQ(1, stats.foreground_writes);
+    EXPECT_EQ(1, stats.buffer_full_errors);
+    EXPECT_EQ(4, stats.read_latency.count());
+    EXPECT_EQ(1, stats.write_latency.count());
+
+    std::ostringstream out;
+    buffer_manager.dump_stats(out);
+    EXPECT_NE(std::string::npos, out.str().find("misses: 5\n"));
+    buffer_manager.reset_stats();
+    EXPECT_EQ(0, buffer_manager.get_stats().misses);
+}
+
+
+// NOLINTNEXTLINE
+TEST(BufferManagerTest, Prefetch) {
+    uint64_t segment_shift = static_cast<uint64_t>(15) << 48;
+    {
+        moderndbs::BufferManager buffer_manager{1024, 10};
+        for (uint64_t i = 0; i < 6; ++i) {
+            auto& page = buffer_manager.fix_page(segment_shift | i, true);
+            std::memset(page.get_data(), static_cast<int>(i), 1024);
+            buffer_manager.unfix_page(page, true);
+        }
+    }
+    moderndbs::BufferManager buffer_manager{1024, 10};
+    // Stops at the end of the segment file.
+    EXPECT_EQ(6, buffer_manager.prefetch(segment_shift, 10));
+    EXPECT_EQ(0, buffer_manager.prefetch(segment_shift, 10));
+    EXPECT_EQ(6, buffer_manager.get_fifo_list().size());
+    {
+        auto& page = buffer_manager.fix_page(segment_shift | 3, false);
+        EXPECT_EQ(3, page.get_data()[0]);
+        buffer_manager.unfix_page(page, false);
+    }
+    // The first fix of a prefetched page does not promote it.
+    EXPECT_TRUE(buffer_manager.get_lru_list().empty());
+    buffer_manager.unfix_page(buffer_manager.fix_page(segment_shift | 3, false), false);
+    EXPECT_EQ(std::vector<uint64_t>{segment_shift | 3}, buffer_manager.get_lru_list());
+    auto stats = buffer_manager.get_stats();
+    EXPECT_EQ(0, stats.misses);
+    EXPECT_EQ(6, stats.prefetches);
+    // The adjacent pages are read with a single request.
+    EXPECT_EQ(1, stats.read_latency.count());
+}
+
+
+// NOLINTNEXTLINE
+TEST(BufferManagerTest, ReadAhead) {
+    uint64_t segment_shift = static_cast<uint64_t>(16) << 48;
+    {
+        moderndbs::BufferManager buffer_manager{1024, 16};
+        for (uint64_t i = 0; i < 16; ++i) {
+            auto& page = buffer_manager.fix_page(segment_shift | i, true);
+            std::memset(page.get_data(), static_cast<int>(i), 1024);
+            buffer_manager.unfix_page(page, true);
+        }
+    }
+    moderndbs::BufferManagerOptions options;
+    options.read_ahead = 4;
+    moderndbs::BufferManager buffer_manager{1024, 8, options};
+    for (uint64_t i = 0; i < 16; ++i) {
+        auto& page = buffer_manager.fix_page(segment_shift | i, false);
+        EXPECT_EQ(static_cast<char>(i), page.get_data()[1023]);
+        buffer_manager.unfix_page(page, false);
+        // The miss returns without waiting for its read-ahead, the first fix
+        // of a page that was read ahead finishes it.
+        if (i == 1) {
+            EXPECT_EQ(0, buffer_manager.get_stats().prefetches);
+        }
+    }
+    // The second miss starts the read-ahead, every later miss is the first
+    // page after a read-ahead window.
+    auto stats = buffer_manager.get_stats();
+    EXPECT_EQ(4, stats.misses);
+    EXPECT_EQ(12, stats.hits);
+    EXPECT_EQ(12, stats.prefetches);
+    EXPECT_TRUE(buffer_manager.get_lru_list().empty());
+}
+
+
+// NOLINTNEXTLINE
+TEST(BufferManagerTest, CoalescedWrites) {
+    uint64_t segment_shift = static_cast<uint64_t>(19) << 48;
+    moderndbs::BufferManagerOptions options;
+    options.clean_fraction = 1.0;
+    options.io_mode = moderndbs::File::BUFFERED;
+    moderndbs::BufferManager buffer_manager{1024, 16, options};
+    // Two runs of adjacent pages, written in reverse order.
+    for (uint64_t i : {13, 12, 11, 10, 4, 3, 2, 1, 0}) {
+        auto& page = buffer_manager.fix_page(segment_shift | i, true);
+        std::memset(page.get_data(), static_cast<int>(i), 1024);
+        buffer_manager.unfix_page(page, true);
+    }
+    buffer_manager.reset_stats();
+    buffer_manager.clean_frames();
+    auto stats = buffer_manager.get_stats();
+    EXPECT_EQ(9, stats.background_writes);
+    EXPECT_EQ(2, stats.write_latency.count());
+
+    auto file = moderndbs::File::open_file("19", moderndbs::File::READ);
+    for (uint64_t i : {13, 12, 11, 10, 4, 3, 2, 1, 0}) {
+        auto block = file->read_block(i * 1024, 1024);
+        EXPECT_EQ(std::vector<char>(1024, static_cast<char>(i)), std::vector<char>(block.get(), block.get() + 1024));
+    }
+}
+
+
+// NOLINTNEXTLINE
+TEST(BufferManagerTest, Shards) {
+    uint64_t segment_shift = static_cast<uint64_t>(17) << 48;
+    moderndbs::BufferManagerOptions options;
+    options.shards = 4;
+    {
+        moderndbs::BufferManager buffer_manager{1024, 8, options};
+        for (uint64_t i = 0; i < 32; ++i) {
+            auto& page = buffer_manager.fix_page(segment_shift | i, true);
+            std::memset(page.get_data(), static_cast<int>(i), 1024);
+            buffer_manager.unfix_page(page, true);
+        }
+        // Every shard keeps its own pages, the pool never exceeds its size.
+        EXPECT_GE(8, buffer_manager.get_fifo_list().size());
+        EXPECT_EQ(32, buffer_manager.get_stats().misses);
+    }
+    // More shards than frames.
+    options.shards = 64;
+    moderndbs::BufferManager buffer_manager{1024, 8, options};
+    for (uint64_t i = 0; i < 32; ++i) {
+        auto& page = buffer_manager.fix_page(segment_shift | i, false);
+        EXPECT_EQ(static_cast<char>(i), page.get_data()[0]);
+        buffer_manager.unfix_page(page, false);
+    }
+}
+
+
+// NOLINTNEXTLINE
+TEST(BufferManagerTest, ReplacementPolicies) {
+    uint64_t segment_shift = static_cast<uint64_t>(20) << 48;
+    for (auto kind : {moderndbs::ReplacementPolicy::TWO_Q, moderndbs::ReplacementPolicy::CLOCK, moderndbs::ReplacementPolicy::LRU_K, moderndbs::ReplacementPolicy::ARC}) {
+        moderndbs::BufferManagerOptions options;
+        options.replacement_policy = kind;
+        moderndbs::BufferManager buffer_manager{1024, 4, options};
+        for (uint64_t i = 0; i < 16; ++i) {
+            auto& page = buffer_manager.fix_page(segment_shift | i, true);
+            std::memset(page.get_data(), static_cast<int>(i + kind), 1024);
+            buffer_manager.unfix_page(page, true);
+        }
+        // Pages that were only read optimistically are still evicted.
+        for (uint64_t i = 12; i < 16; ++i) {
+            uint64_t version;
+            auto& page = buffer_manager.fix_page_optimistic(segment_shift | i, version);
+            EXPECT_TRUE(moderndbs::BufferManager::validate_page(page, version));
+        }
+        for (uint64_t round = 0; round < 2; ++round) {
+            for (uint64_t i = 0; i < 16; ++i) {
+                auto& page = buffer_manager.fix_page(segment_shift | i, false);
+                EXPECT_EQ(static_cast<char>(i + kind), page.get_data()[0]) << kind;
+                buffer_manager.unfix_page(page, false);
+            }
+        }
+        auto fifo = buffer_manager.get_fifo_list();
+        auto lru = buffer_manager.get_lru_list();
+        EXPECT_GE(4, fifo.size() + lru.size()) << kind;
+    }
+}
+
+
+// NOLINTNEXTLINE
+TEST(BufferManagerTest, FlushSegment) {
+    uint64_t segment_shift = static_cast<uint64_t>(22) << 48;
+    uint64_t other_shift = static_cast<uint64_t>(23) << 48;
+    // Segment 23 must not exist before it is flushed.
+    std::remove("23");
+    moderndbs::BufferManagerOptions options;
+    options.io_mode = moderndbs::File::BUFFERED;
+    options.write_batch_size = 2;
+    moderndbs::BufferManager buffer_manager{1024, 8, options};
+    for (uint64_t i = 0; i < 5; ++i) {
+        auto& page = buffer_manager.fix_page(segment_shift | i, true);
+        std::memset(page.get_data(), static_cast<int>(i + 1), 1024);
+        buffer_manager.unfix_page(page, true);
+    }
+    auto& other = buffer_manager.fix_page(other_shift, true);
+    std::memset(other.get_data(), 42, 1024);
+    buffer_manager.unfix_page(other, true);
+    // Pages that are fixed shared are written as well.
+    auto& fixed = buffer_manager.fix_page(segment_shift | 4, false);
+    buffer_manager.flush_segment(22);
+    buffer_manager.unfix_page(fixed, false);
+    EXPECT_EQ(5, buffer_manager.get_stats().flush_writes);
+    {
+        auto file = moderndbs::File::open_file("22", moderndbs::File::READ);
+        for (uint64_t i = 0; i < 5; ++i) {
+            auto block = file->read_block(i * 1024, 1024);
+            EXPECT_EQ(std::vector<char>(1024, static_cast<char>(i + 1)), std::vector<char>(block.get(), block.get() + 1024));
+        }
+        EXPECT_EQ(0, moderndbs::File::open_file("23", moderndbs::File::READ)->size());
+    }
+    // Clean pages are not written again.
+    buffer_manager.flush_all();
+    EXPECT_EQ(6, buffer_manager.get_stats().flush_writes);
+    auto block = moderndbs::File::open_file("23", moderndbs::File::READ)->read_block(0, 1024);
+    EXPECT_EQ(std::vector<char>(1024, 42), std::vector<char>(block.get(), block.get() + 1024));
+}
+
+
+// NOLINTNEXTLINE
+TEST(BufferManagerTest, Checkpoint) {
+    uint64_t segment_shift = static_cast<uint64_t>(24) << 48;
+    moderndbs::BufferManagerOptions options;
+    options.io_mode = moderndbs::File::BUFFERED;
+    moderndbs::BufferManager buffer_manager{1024, 4, options};
+    for (uint64_t i = 0; i < 4; ++i) {
+        auto& page = buffer_manager.fix_page(segment_shift | i, true);
+        *reinterpret_cast<uint64_t*>(page.get_data()) = i + 42;
+        buffer_manager.unfix_page(page, true);
+    }
+    // The checkpoint does not wait for the exclusive fix.
+    auto& page = buffer_manager.fix_page(segment_shift | 2, true);
+    EXPECT_EQ(3, buffer_manager.checkpoint());
+    buffer_manager.unfix_page(page, true);
+    EXPECT_EQ(1, buffer_manager.checkpoint());
+    EXPECT_EQ(0, buffer_manager.checkpoint());
+    auto file = moderndbs::File::open_file("24", moderndbs::File::READ);
+    for (uint64_t i = 0; i < 4; ++i) {
+        auto block = file->read_block(i * 1024, sizeof(uint64_t));
+        EXPECT_EQ(i + 42, *reinterpret_cast<uint64_t*>(block.get()));
+    }
+}
+
+
+// NOLINTNEXTLINE
+TEST(BufferManagerTest, FlushSwizzled) {
+    uint64_t segment_shift = static_cast<uint64_t>(25) << 48;
+    moderndbs::BufferManager buffer_manager{1024, 4};
+    auto& parent = buffer_manager.fix_page(segment_shift, true);
+    auto* swips = reinterpret_cast<moderndbs::Swip*>(parent.get_data());
+    new (swips) moderndbs::Swip{segment_shift | 1};
+    auto& child = buffer_manager.fix_swip(parent, swips[0], false);
+    buffer_manager.unfix_page(child, false);
+    buffer_manager.unfix_page(parent, true);
+    ASSERT_TRUE(swips[0].is_swizzled());
+    // The background writer skips the parent, a flush unswizzles its child.
+    buffer_manager.checkpoint();
+    EXPECT_EQ(0, buffer_manager.get_stats().flush_writes);
+    buffer_manager.flush_all();
+    EXPECT_EQ(1, buffer_manager.get_stats().flush_writes);
+    EXPECT_FALSE(swips[0].is_swizzled());
+    auto block = moderndbs::File::open_file("25", moderndbs::File::READ)->read_block(0, sizeof(uint64_t));
+    EXPECT_EQ(segment_shift | 1, *reinterpret_cast<uint64_t*>(block.get()));
+}
+
+
+// NOLINTNEXTLINE
+TEST(BufferManagerTest, MappedSegment) {
+    uint64_t segment_shift = static_cast<uint64_t>(31) << 48;
+    std::remove("31");
+    {
+        moderndbs::BufferManager buffer_manager{1024, 2};
+        for (uint64_t i = 0; i < 8; ++i) {
+            auto& page = buffer_manager.fix_page(segment_shift | i, true);
+            std::memset(page.get_data(), static_cast<int>(i), 1024);
+            // Page 0 references page 1 through a swip.
+            if (i == 0) {
+                new (page.get_data()) moderndbs::Swip{segment_shift | 1};
+            }
+            buffer_manager.unfix_page(page, true);
+        }
+    }
+    moderndbs::BufferManagerOptions options;
+    options.mapped_segments[31] = moderndbs::BufferManagerOptions::SEQUENTIAL;
+    moderndbs::BufferManager buffer_manager{1024, 2, options};
+    // All pages are fixed at once, far more than the pool holds.
+    std::vector<moderndbs::BufferFrame*> pages;
+    for (uint64_t i = 0; i < 8; ++i) {
+        pages.push_back(&buffer_manager.fix_page(segment_shift | i, false));
+        EXPECT_EQ(static_cast<char>(i), pages.back()->get_data()[1023]);
+    }
+    EXPECT_EQ(&buffer_manager.fix_page(segment_shift | 3, false), pages[3]);
+    buffer_manager.unfix_page(*pages[3], false);
+    auto& child = buffer_manager.fix_swip(*pages[0], *reinterpret_cast<moderndbs::Swip*>(pages[0]->get_data()), false);
+    EXPECT_EQ(pages[1], &child);
+    EXPECT_FALSE(reinterpret_cast<moderndbs::Swip*>(pages[0]->get_data())->is_swizzled());
+    buffer_manager.unfix_page(child, false);
+    for (auto* page : pages) {
+        buffer_manager.unfix_page(*page, false);
+    }
+    uint64_t version;
+    auto& page = buffer_manager.fix_page_optimistic(segment_shift | 5, version);
+    EXPECT_EQ(5, page.get_data()[0]);
+    EXPECT_TRUE(buffer_manager.validate_page(page, version));
+    EXPECT_EQ(3, buffer_manager.prefetch(segment_shift | 5, 10));
+
+    EXPECT_THROW(buffer_manager.fix_page(segment_shift | 2, true), std::invalid_argument);
+    EXPECT_THROW(buffer_manager.fix_page(segment_shift | 8, false), std::out_of_range);
+    auto stats = buffer_manager.get_stats();
+    EXPECT_EQ(11, stats.mapped_fixes);
+    EXPECT_EQ(0, stats.hits + stats.misses);
+    EXPECT_TRUE(buffer_manager.get_fifo_list().empty());
+    // Other segments still go through the pool.
+    auto& pooled = buffer_manager.fix_page(1, false);
+    buffer_manager.unfix_page(pooled, false);
+    EXPECT_EQ(std::vector<uint64_t>{1}, buffer_manager.get_fifo_list());
+    std::remove("31");
+}
+
+
+// NOLINTNEXTLINE
+TEST(BufferManagerTest, NumaPartitions) {
+    uint64_t segment_shift = static_cast<uint64_t>(35) << 48;
+    std::remove("35");
+    moderndbs::BufferManagerOptions options;
+    options.numa = true;
+    options.shards = 2;
+    {
+        moderndbs::BufferManager buffer_manager{1024, 10, options};
+        size_t node_count = buffer_manager.get_numa_node_count();
+        EXPECT_GE(node_count, 1);
+        for (uint64_t round = 0; round < 2; ++round) {
+            for (uint64_t i = 0; i < 20; ++i) {
+                auto& page = buffer_manager.fix_page(segment_shift | i, round == 0);
+                if (round == 0) {
+                    std::memset(page.get_data(), static_cast<int>(i), 1024);
+                } else {
+                    EXPECT_EQ(static_cast<char>(i), page.get_data()[1023]);
+                }
+                buffer_manager.unfix_page(page, round == 0);
+            }
+        }
+        // Every fix is counted once, and all are local on a single node.
+        auto stats = buffer_manager.get_stats();
+        EXPECT_EQ(stats.hits + stats.misses, stats.local_fixes + stats.remote_fixes);
+        if (node_count == 1) {
+            EXPECT_EQ(0, stats.remote_fixes);
+        }
+    }
+    // Without NUMA mode nothing is counted.
+    moderndbs::BufferManager buffer_manager{1024, 10};
+    EXPECT_EQ(1, buffer_manager.get_numa_node_count());
+    buffer_manager.unfix_page(buffer_manager.fix_page(segment_shift, false), false);
+    EXPECT_EQ(0, buffer_manager.get_stats().local_fixes);
+    std::remove("35");
+}
+
+
+// NOLINTNEXTLINE
+TEST(BufferManagerTest, PageChecksums) {
+    uint64_t segment_shift = static_cast<uint64_t>(36) << 48;
+    std::remove("36");
+    moderndbs::BufferManagerOptions options;
+    options.page_checksums = true;
+    {
+        moderndbs::BufferManager buffer_manager{1024, 10, options};
+        // Page 3 stays a hole in the file.
+        for (uint64_t i : {0, 1, 2, 4}) {
+            auto& page = buffer_manager.fix_page(segment_shift | i, true);
+            std::memset(page.get_data() + 64, static_cast<int>(i + 1), 1024 - 64);
+            buffer_manager.unfix_page(page, true);
+        }
+    }
+    // Flip a bit of page 1.
+    {
+        auto* file = std::fopen("36", "r+b");
+        ASSERT_NE(nullptr, file);
+        std::fseek(file, 1024 + 500, SEEK_SET);
+        std::fputc(2 ^ 0x10, file);
+        std::fclose(file);
+    }
+    moderndbs::BufferManager buffer_manager{1024, 10, options};
+    for (uint64_t i : {0, 2, 3, 4}) {
+        auto& page = buffer_manager.fix_page(segment_shift | i, false);
+        EXPECT_EQ(static_cast<char>(i == 3 ? 0 : i + 1), page.get_data()[1023]);
+        buffer_manager.unfix_page(page, false);
+    }
+    EXPECT_THROW(buffer_manager.fix_page(segment_shift | 1, false), moderndbs::checksum_error);
+    EXPECT_EQ(1, buffer_manager.get_stats().checksum_errors);
+    // The frame of the failed read was given back, so the next fix reads the
+    // page again instead of waiting for it.
+    EXPECT_THROW(buffer_manager.fix_page(segment_shift | 1, true), moderndbs::checksum_error);
+    EXPECT_EQ(2, buffer_manager.get_stats().checksum_errors);
+    EXPECT_EQ(4, buffer_manager.get_fifo_list().size());
+    // The same holds for a page that was read ahead.
+    EXPECT_THROW(buffer_manager.prefetch(segment_shift | 1, 1), moderndbs::checksum_error);
+    EXPECT_THROW(buffer_manager.fix_page(segment_shift | 1, false), moderndbs::checksum_error);
+    EXPECT_EQ(4, buffer_manager.get_stats().checksum_errors);
+    // Without checksums the corrupt page is read as it is.
+    {
+        moderndbs::BufferManager unchecked{1024, 10};
+        auto& page = unchecked.fix_page(segment_shift | 1, false);
+        EXPECT_EQ(2 ^ 0x10, page.get_data()[500]);
+        unchecked.unfix_page(page, false);
+    }
+    EXPECT_THROW((moderndbs::BufferManager{8, 10, options}), std::invalid_argument);
+    std::remove("36");
+}
+
+
+// NOLINTNEXTLINE
+TEST(BufferManagerTest, ReuseEvictedFrame) {
+    moderndbs::BufferManager buffer_manager{1024, 1};
+    uint64_t segment_shift = static_cast<uint64_t>(7) << 48;
+    {
+        auto& page = buffer_manager.fix_page(segment_shift | 1, true);
+        std::memset(page.get_data(), 0xAB, 1024);
+        buffer_manager.unfix_page(page, true);
+    }
+    {
+        // Evicts page 1 and reuses its frame for a page past the end of the
+        // segment file, which must read as zeros.
+        auto& page = buffer_manager.fix_page(segment_shift | 1000, false);
+        std::vector<char> values(page.get_data(), page.get_data() + 1024);
+        buffer_manager.unfix_page(page, false);
+        EXPECT_EQ(std::vector<char>(1024, 0), values);
+        EXPECT_EQ(std::vector<uint64_t>{segment_shift | 1000}, buffer_manager.get_fifo_list());
+    }
+    {
+        auto& page = buffer_manager.fix_page(segment_shift | 1, false);
+        std::vector<char> values(page.get_data(), page.get_data() + 1024);
+        buffer_manager.unfix_page(page, false);
+        EXPECT_EQ(std::vector<char>(1024, static_cast<char>(0xAB)), values);
+    }
+}
+
+
+// NOLINTNEXTLINE
+TEST(BufferManagerTest, CleanColdFrames) {
+    uint64_t segment_shift = static_cast<uint64_t>(8) << 48;
+    {
+        moderndbs::BufferManagerOptions options;
+        options.clean_fraction = 0.5;
+        options.write_batch_size = 2;
+        moderndbs::BufferManager buffer_manager{1024, 10, options};
+        for (uint64_t i = 0; i < 10; ++i) {
+            auto& page = buffer_manager.fix_page(segment_shift | i, true);
+            *reinterpret_cast<uint64_t*>(page.get_data()) = i + 42;
+            buffer_manager.unfix_page(page, true);
+        }
+        // Only the 5 coldest pages are written.
+        buffer_manager.clean_frames();
+        EXPECT_EQ(5, buffer_manager.get_background_writes());
+        for (uint64_t i = 10; i < 15; ++i) {
+            auto& page = buffer_manager.fix_page(segment_shift | i, false);
+            buffer_manager.unfix_page(page, false);
+        }
+        EXPECT_EQ(0, buffer_manager.get_foreground_writes());
+        auto& page = buffer_manager.fix_page(segment_shift | 15, false);
+        buffer_manager.unfix_page(page, false);
+        EXPECT_EQ(1, buffer_manager.get_foreground_writes());
+    }
+    moderndbs::BufferManager buffer_manager{1024, 10};
+    for (uint64_t i = 0; i < 10; ++i) {
+        auto& page = buffer_manager.fix_page(segment_shift | i, false);
+        uint64_t value = *reinterpret_cast<uint64_t*>(page.get_data());
+        buffer_manager.unfix_page(page, false);
+        EXPECT_EQ(i + 42, value);
+    }
+}
+
+
+// NOLINTNEXTLINE
+TEST(BufferManagerTest, OptimisticRead) {
+    moderndbs::BufferManager buffer_manager{1024, 2};
+    uint64_t segment_shift = static_cast<uint64_t>(10) << 48;
+    {
+        auto& page = buffer_manager.fix_page(segment_shift | 1, true);
+        *reinterpret_cast<uint64_t*>(page.get_data()) = 42;
+        buffer_manager.unfix_page(page, true);
+    }
+    uint64_t version = 0;
+    auto& page = buffer_manager.fix_page_optimistic(segment_shift | 1, version);
+    EXPECT_EQ(42, *reinterpret_cast<uint64_t*>(page.get_data()));
+    EXPECT_TRUE(moderndbs::BufferManager::validate_page(page, version));
+    // Shared fixes do not invalidate optimistic reads, exclusive ones do.
+    buffer_manager.unfix_page(buffer_manager.fix_page(segment_shift | 1, false), false);
+    EXPECT_TRUE(moderndbs::BufferManager::validate_page(page, version));
+    buffer_manager.unfix_page(buffer_manager.fix_page(segment_shift | 1, true), false);
+    EXPECT_FALSE(moderndbs::BufferManager::validate_page(page, version));
+}
+
+
+// NOLINTNEXTLINE
+TEST(BufferManagerTest, OptimisticReadEvict) {
+    moderndbs::BufferManager buffer_manager{1024, 2};
+    uint64_t version = 0;
+    // A page that is not resident is loaded.
+    auto& page = buffer_manager.fix_page_optimistic(1, version);
+    EXPECT_TRUE(moderndbs::BufferManager::validate_page(page, version));
+    EXPECT_EQ(std::vector<uint64_t>{1}, buffer_manager.get_fifo_list());
+    // Optimistically read pages get a second chance on eviction.
+    buffer_manager.unfix_page(buffer_manager.fix_page(2, false), false);
+    buffer_manager.unfix_page(buffer_manager.fix_page(3, false), false);
+    EXPECT_EQ(std::vector<uint64_t>{3}, buffer_manager.get_fifo_list());
+    EXPECT_EQ(std::vector<uint64_t>{1}, buffer_manager.get_lru_list());
+    EXPECT_TRUE(moderndbs::BufferManager::validate_page(page, version));
+    // The second chance moved the page to the LRU list.
+    EXPECT_EQ(1, buffer_manager.get_stats().promotions);
+}
+
+
+// NOLINTNEXTLINE
+TEST(BufferManagerTest, Swizzle) {
+    uint64_t segment_shift = static_cast<uint64_t>(12) << 48;
+    uint64_t parent_id = segment_shift;
+    {
+        moderndbs::BufferManager buffer_manager{1024, 3};
+        {
+            auto& parent = buffer_manager.fix_page(parent_id, true);
+            for (uint64_t i = 0; i < 3; ++i) {
+                new (parent.get_data() + i * sizeof(moderndbs::Swip)) moderndbs::Swip{segment_shift | (i + 1)};
+            }
+            buffer_manager.unfix_page(parent, true);
+        }
+        auto& parent = buffer_manager.fix_page(parent_id, false);
+        auto* swips = reinterpret_cast<moderndbs::Swip*>(parent.get_data());
+        auto& child1 = buffer_manager.fix_swip(parent, swips[0], false);
+        buffer_manager.unfix_page(child1, false);
+        EXPECT_TRUE(swips[0].is_swizzled());
+        EXPECT_EQ(segment_shift | 1, swips[0].get_page_id());
+        // The second access only goes through the swip.
+        auto& swizzled = buffer_manager.fix_swip(parent, swips[0], false);
+        buffer_manager.unfix_page(swizzled, false);
+        EXPECT_EQ(&child1, &swizzled);
+        auto& child2 = buffer_manager.fix_swip(parent, swips[1], false);
+        buffer_manager.unfix_page(child2, false);
+        buffer_manager.unfix_page(parent, false);
+        EXPECT_EQ((std::vector<uint64_t>{segment_shift | 1, segment_shift | 2}), buffer_manager.get_fifo_list());
+        EXPECT_EQ(std::vector<uint64_t>{parent_id}, buffer_manager.get_lru_list());
+
+        // Child 1 gets a second chance, child 2 is evicted and unswizzled.
+        // The parent stays, it still has a swizzled child.
+        buffer_manager.unfix_page(buffer_manager.fix_page(segment_shift | 100, false), false);
+        EXPECT_EQ(std::vector<uint64_t>{segment_shift | 100}, buffer_manager.get_fifo_list());
+        EXPECT_EQ((std::vector<uint64_t>{parent_id, segment_shift | 1}), buffer_manager.get_lru_list());
+        EXPECT_TRUE(swips[0].is_swizzled());
+        EXPECT_FALSE(swips[1].is_swizzled());
+        EXPECT_EQ(segment_shift | 2, swips[1].get_page_id());
+        buffer_manager.unfix_page(buffer_manager.fix_page(segment_shift | 101, false), false);
+        EXPECT_EQ(std::vector<uint64_t>{segment_shift | 101}, buffer_manager.get_fifo_list());
+        EXPECT_EQ((std::vector<uint64_t>{parent_id, segment_shift | 1}), buffer_manager.get_lru_list());
+    }
+    // Only page ids are written.
+    moderndbs::BufferManager buffer_manager{1024, 3};
+    auto& parent = buffer_manager.fix_page(parent_id, false);
+    auto* swips = reinterpret_cast<moderndbs::Swip*>(parent.get_data());
+    for (uint64_t i = 0; i < 3; ++i) {
+        EXPECT_FALSE(swips[i].is_swizzled());
+        EXPECT_EQ(segment_shift | (i + 1), swips[i].get_page_id());
+    }
+    buffer_manager.unfix_page(parent, false);
+}
+
+
 // NOLINTNEXTLINE
 TEST(BufferManagerTest, MultithreadParallelFix) {
     moderndbs::BufferManager buffer_manager{1024, 10};
@@ -247,6 +886,210 @@ TEST(BufferManagerTest, MultithreadManyPages) {
 }
 
 
+// NOLINTNEXTLINE
+TEST(BufferManagerTest, MultithreadShards) {
+    uint64_t segment_shift = static_cast<uint64_t>(18) << 48;
+    moderndbs::BufferManagerOptions options;
+    options.shards = 8;
+    moderndbs::BufferManager buffer_manager{1024, 64, options};
+    for (uint64_t i = 0; i < 256; ++i) {
+        auto& page = buffer_manager.fix_page(segment_shift | i, true);
+        std::memset(page.get_data(), 0, 1024);
+        buffer_manager.unfix_page(page, true);
+    }
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < 4; ++i) {
+        threads.emplace_back([i, segment_shift, &buffer_manager] {
+            // Each thread owns the pages i, i + 4, ... and counts their
+            // writes in the first value.
+            std::mt19937_64 engine{i};
+            std::uniform_int_distribution<uint64_t> distr{0, 63};
+            std::vector<uint64_t> writes(256);
+            for (size_t j = 0; j < 10000; ++j) {
+                uint64_t page_id = distr(engine) * 4 + i;
+                auto& page = buffer_manager.fix_page(segment_shift | page_id, true);
+                auto& value = *reinterpret_cast<uint64_t*>(page.get_data());
+                EXPECT_EQ(writes[page_id], value);
+                value = ++writes[page_id];
+                buffer_manager.unfix_page(page, true);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+
+// NOLINTNEXTLINE
+TEST(BufferManagerTest, MultithreadBackgroundWriter) {
+    moderndbs::BufferManagerOptions options;
+    options.background_writer = true;
+    options.clean_fraction = 1.0;
+    options.writer_interval = std::chrono::milliseconds{1};
+    moderndbs::BufferManager buffer_manager{1024, 10, options};
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < 4; ++i) {
+        threads.emplace_back([i, &buffer_manager] {
+            std::mt19937_64 engine{i};
+            std::uniform_int_distribution<uint64_t> page_distr{0, 19};
+            for (size_t j = 0; j < 1000; ++j) {
+                moderndbs::BufferFrame* page;
+                try {
+                    page = &buffer_manager.fix_page(page_distr(engine), true);
+                } catch (const moderndbs::buffer_full_error&) {
+                    continue;
+                }
+                ++*reinterpret_cast<uint64_t*>(page->get_data());
+                buffer_manager.unfix_page(*page, true);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    // The writer runs every millisecond, so it eventually cleans pages.
+    while (buffer_manager.get_background_writes() == 0) {
+        std::this_thread::yield();
+    }
+    EXPECT_GT(buffer_manager.get_background_writes(), 0);
+}
+
+
+// NOLINTNEXTLINE
+TEST(BufferManagerTest, MultithreadFlushAll) {
+    uint64_t segment_shift = static_cast<uint64_t>(26) << 48;
+    moderndbs::BufferManagerOptions options;
+    options.io_mode = moderndbs::File::BUFFERED;
+    moderndbs::BufferManager buffer_manager{1024, 16, options};
+    for (uint64_t i = 0; i < 16; ++i) {
+        auto& page = buffer_manager.fix_page(segment_shift | i, true);
+        *reinterpret_cast<uint64_t*>(page.get_data()) = 0;
+        buffer_manager.unfix_page(page, true);
+    }
+    buffer_manager.flush_all();
+    {
+        auto& page = buffer_manager.fix_page(segment_shift | 7, true);
+        *reinterpret_cast<uint64_t*>(page.get_data()) = 41;
+        buffer_manager.unfix_page(page, true);
+    }
+    // A writer holds the dirty page 7 exclusively while the flush starts,
+    // the flush must wait for it.
+    std::atomic<bool> fixed = false;
+    std::thread writer([&] {
+        auto& page = buffer_manager.fix_page(segment_shift | 7, true);
+        fixed = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        *reinterpret_cast<uint64_t*>(page.get_data()) = 42;
+        buffer_manager.unfix_page(page, true);
+    });
+    while (!fixed) {
+        std::this_thread::yield();
+    }
+    for (uint64_t i = 0; i < 16; i += 2) {
+        auto& page = buffer_manager.fix_page(segment_shift | i, true);
+        *reinterpret_cast<uint64_t*>(page.get_data()) = i + 1;
+        buffer_manager.unfix_page(page, true);
+    }
+    buffer_manager.flush_all();
+    writer.join();
+    auto file = moderndbs::File::open_file("26", moderndbs::File::READ);
+    for (uint64_t i = 0; i < 16; ++i) {
+        auto block = file->read_block(i * 1024, sizeof(uint64_t));
+        uint64_t expected = i == 7 ? 42 : (i % 2 == 0 ? i + 1 : 0);
+        EXPECT_EQ(expected, *reinterpret_cast<uint64_t*>(block.get()));
+    }
+}
+
+
+// NOLINTNEXTLINE
+TEST(BufferManagerTest, MultithreadOptimisticRead) {
+    moderndbs::BufferManager buffer_manager{1024, 10};
+    uint64_t segment_shift = static_cast<uint64_t>(11) << 48;
+    std::atomic<size_t> validated = 0;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < 4; ++i) {
+        threads.emplace_back([i, segment_shift, &buffer_manager, &validated] {
+            std::mt19937_64 engine{i};
+            // More pages than frames, so pages are also evicted while they
+            // are read optimistically.
+            std::uniform_int_distribution<uint64_t> page_distr{0, 19};
+            for (size_t j = 0; j < 10000; ++j) {
+                uint64_t page_id = segment_shift | page_distr(engine);
+                if (i == 0) {
+                    // Writers keep both values of a page equal.
+                    auto& page = buffer_manager.fix_page(page_id, true);
+                    auto* values = reinterpret_cast<uint64_t*>(page.get_data());
+                    ++values[0];
+                    values[1] = values[0];
+                    buffer_manager.unfix_page(page, true);
+                    continue;
+                }
+                uint64_t version;
+                auto& page = buffer_manager.fix_page_optimistic(page_id, version);
+                auto* values = reinterpret_cast<volatile uint64_t*>(page.get_data());
+                uint64_t first = values[0];
+                uint64_t second = values[1];
+                if (moderndbs::BufferManager::validate_page(page, version)) {
+                    EXPECT_EQ(first, second);
+                    ++validated;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_GT(validated.load(), 0);
+}
+
+
+// NOLINTNEXTLINE
+TEST(BufferManagerTest, MultithreadSwizzle) {
+    uint64_t segment_shift = static_cast<uint64_t>(13) << 48;
+    uint64_t parent_id = segment_shift;
+    moderndbs::BufferManager buffer_manager{1024, 10};
+    {
+        auto& parent = buffer_manager.fix_page(parent_id, true);
+        for (uint64_t i = 0; i < 20; ++i) {
+            new (parent.get_data() + i * sizeof(moderndbs::Swip)) moderndbs::Swip{segment_shift | (i + 1)};
+            auto& page = buffer_manager.fix_page(segment_shift | (i + 1), true);
+            std::memset(page.get_data(), 0, 1024);
+            buffer_manager.unfix_page(page, true);
+        }
+        buffer_manager.unfix_page(parent, true);
+    }
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < 4; ++i) {
+        threads.emplace_back([i, &buffer_manager, parent_id] {
+            std::mt19937_64 engine{i};
+            // More children than frames, so children are evicted all the time.
+            std::uniform_int_distribution<uint64_t> child_distr{0, 19};
+            for (size_t j = 0; j < 10000; ++j) {
+                auto& parent = buffer_manager.fix_page(parent_id, false);
+                auto* swips = reinterpret_cast<moderndbs::Swip*>(parent.get_data());
+                uint64_t child = child_distr(engine);
+                auto& page = buffer_manager.fix_swip(parent, swips[child], true);
+                EXPECT_EQ(swips[child].get_page_id(), page.pageid);
+                ++*reinterpret_cast<uint64_t*>(page.get_data());
+                buffer_manager.unfix_page(page, true);
+                buffer_manager.unfix_page(parent, false);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    uint64_t sum = 0;
+    for (uint64_t i = 1; i <= 20; ++i) {
+        auto& page = buffer_manager.fix_page(parent_id + i, false);
+        sum += *reinterpret_cast<uint64_t*>(page.get_data());
+        buffer_manager.unfix_page(page, false);
+    }
+    EXPECT_EQ(4 * 10000, sum);
+}
+
+
 // NOLINTNEXTLINE
 TEST(BufferManagerTest, MultithreadReaderWriter) {
     {
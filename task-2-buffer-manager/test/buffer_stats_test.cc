@@ -0,0 +1,68 @@
+#include <chrono>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "moderndbs/buffer_stats.h"
+
+
+namespace {
+
+// NOLINTNEXTLINE
+TEST(BufferStatsTest, HistogramBuckets) {
+    using std::chrono::nanoseconds;
+    EXPECT_EQ(0, moderndbs::LatencyHistogram::get_bucket(nanoseconds{0}));
+    EXPECT_EQ(0, moderndbs::LatencyHistogram::get_bucket(nanoseconds{1}));
+    EXPECT_EQ(1, moderndbs::LatencyHistogram::get_bucket(nanoseconds{3}));
+    EXPECT_EQ(10, moderndbs::LatencyHistogram::get_bucket(nanoseconds{1024}));
+    EXPECT_EQ(moderndbs::LatencyHistogram::bucket_count - 1,
+              moderndbs::LatencyHistogram::get_bucket(std::chrono::hours{24 * 365}));
+
+    moderndbs::LatencyHistogram histogram;
+    EXPECT_EQ(0, histogram.percentile(0.5));
+    // 90 latencies in [1024, 2048), 10 in [65536, 131072).
+    histogram.buckets[10] = 90;
+    histogram.buckets[16] = 10;
+    EXPECT_EQ(100, histogram.count());
+    EXPECT_EQ(2048, histogram.percentile(0.5));
+    EXPECT_EQ(131072, histogram.percentile(0.99));
+    EXPECT_EQ(131072, histogram.percentile(1.0));
+}
+
+
+// NOLINTNEXTLINE
+TEST(BufferStatsTest, CollectShards) {
+    moderndbs::StatsCounters counters;
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < 8; ++i) {
+        threads.emplace_back([&counters] {
+            for (size_t j = 0; j < 1000; ++j) {
+                counters.add(moderndbs::StatsCounters::HITS);
+                counters.record_io(j % 2 == 0, std::chrono::microseconds{10});
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    counters.add(moderndbs::StatsCounters::LATCH_WAIT_NS, 42);
+    auto stats = counters.collect();
+    EXPECT_EQ(8000, stats.hits);
+    EXPECT_EQ(8000, counters.get(moderndbs::StatsCounters::HITS));
+    EXPECT_EQ(42, stats.latch_wait_ns);
+    EXPECT_EQ(4000, stats.read_latency.count());
+    EXPECT_EQ(4000, stats.write_latency.count());
+    EXPECT_EQ(16384, stats.write_latency.percentile(0.5));
+
+    std::ostringstream out;
+    stats.dump(out);
+    EXPECT_NE(std::string::npos, out.str().find("hits: 8000\n"));
+    EXPECT_NE(std::string::npos, out.str().find("write latency: count=4000"));
+
+    counters.reset();
+    EXPECT_EQ(0, counters.collect().hits);
+    EXPECT_EQ(0, counters.collect().read_latency.count());
+}
+
+}  // namespace
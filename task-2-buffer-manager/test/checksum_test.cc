@@ -0,0 +1,53 @@
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "moderndbs/checksum.h"
+
+
+namespace {
+
+// NOLINTNEXTLINE
+TEST(ChecksumTest, KnownValues) {
+    // Test vectors of RFC 3720, appendix B.4.
+    std::string digits = "123456789";
+    EXPECT_EQ(0xE3069283, moderndbs::crc32c(digits.data(), digits.size()));
+    EXPECT_EQ(0xE3069283, moderndbs::crc32c_software(digits.data(), digits.size()));
+    std::vector<char> zeros(32, 0);
+    EXPECT_EQ(0x8A9136AA, moderndbs::crc32c(zeros.data(), zeros.size()));
+    std::vector<char> ones(32, static_cast<char>(0xFF));
+    EXPECT_EQ(0x62A8AB43, moderndbs::crc32c(ones.data(), ones.size()));
+    EXPECT_EQ(0, moderndbs::crc32c(nullptr, 0));
+}
+
+
+// NOLINTNEXTLINE
+TEST(ChecksumTest, HardwareMatchesSoftware) {
+    std::mt19937_64 engine{0};
+    std::vector<char> data(4096 + 7);
+    for (auto& byte : data) {
+        byte = static_cast<char>(engine());
+    }
+    // All alignments and sizes that are not a multiple of 8.
+    for (size_t offset = 0; offset < 8; ++offset) {
+        for (size_t size : {0, 1, 7, 8, 9, 63, 767, 768, 1000, 1541, 4096}) {
+            EXPECT_EQ(moderndbs::crc32c_software(data.data() + offset, size), moderndbs::crc32c(data.data() + offset, size));
+        }
+    }
+}
+
+
+// NOLINTNEXTLINE
+TEST(ChecksumTest, Continue) {
+    std::string text = "The quick brown fox jumps over the lazy dog";
+    uint32_t whole = moderndbs::crc32c(text.data(), text.size());
+    for (size_t split = 0; split <= text.size(); ++split) {
+        uint32_t crc = moderndbs::crc32c(text.data(), split);
+        EXPECT_EQ(whole, moderndbs::crc32c(text.data() + split, text.size() - split, crc));
+        crc = moderndbs::crc32c_software(text.data(), split);
+        EXPECT_EQ(whole, moderndbs::crc32c_software(text.data() + split, text.size() - split, crc));
+    }
+}
+
+}  // namespace
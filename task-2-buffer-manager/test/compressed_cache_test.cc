@@ -0,0 +1,142 @@
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <gtest/gtest.h>
+#include "moderndbs/buffer_manager.h"
+#include "moderndbs/compressed_cache.h"
+
+
+namespace {
+
+using moderndbs::CompressedCache;
+
+
+/// Returns a page of records that share most of their bytes.
+std::vector<char> make_page(size_t size, uint64_t seed) {
+    std::vector<char> page(size, 0);
+    for (size_t i = 0; i + 16 <= size / 2; i += 16) {
+        uint64_t key = seed * 1000 + i;
+        std::memcpy(page.data() + i, &key, sizeof(key));
+        std::memcpy(page.data() + i + 8, "record", 6);
+    }
+    return page;
+}
+
+
+// NOLINTNEXTLINE
+TEST(CompressedCacheTest, RoundTrip) {
+    std::mt19937_64 engine{0};
+    std::vector<std::vector<char>> pages;
+    pages.push_back(std::vector<char>(4096, 0));
+    pages.push_back(make_page(4096, 1));
+    // Long literal runs and long matches need extra length bytes.
+    std::vector<char> mixed(4096);
+    for (size_t i = 0; i < 1000; ++i) {
+        mixed[i] = static_cast<char>(engine());
+    }
+    std::memcpy(mixed.data() + 1000, mixed.data(), 1000);
+    pages.push_back(mixed);
+    pages.push_back(std::vector<char>(3, 'a'));
+
+    for (auto& page : pages) {
+        std::vector<char> compressed(page.size() + 64);
+        size_t size = CompressedCache::compress(page.data(), page.size(), compressed.data(), compressed.size());
+        ASSERT_GT(size, 0);
+        std::vector<char> restored(page.size());
+        CompressedCache::decompress(compressed.data(), size, restored.data(), restored.size());
+        EXPECT_EQ(page, restored);
+    }
+    std::vector<char> compressed(4096);
+    EXPECT_LT(CompressedCache::compress(pages[0].data(), 4096, compressed.data(), compressed.size()), 64);
+    EXPECT_LT(CompressedCache::compress(mixed.data(), 4096, compressed.data(), compressed.size()), 1200);
+
+    // Random bytes do not compress.
+    std::vector<char> random(4096);
+    for (auto& byte : random) {
+        byte = static_cast<char>(engine());
+    }
+    EXPECT_EQ(0, CompressedCache::compress(random.data(), random.size(), compressed.data(), 4095));
+}
+
+
+// NOLINTNEXTLINE
+TEST(CompressedCacheTest, ReserveInsertTake) {
+    auto page = make_page(1024, 1);
+    CompressedCache cache{1024, 1 << 20};
+    // Only reserved pages are stored.
+    EXPECT_FALSE(cache.insert(1, page.data()));
+    cache.reserve(1);
+    EXPECT_TRUE(cache.insert(1, page.data()));
+    EXPECT_EQ(1, cache.get_page_count());
+    auto compressed = cache.take(1);
+    ASSERT_FALSE(compressed.empty());
+    std::vector<char> restored(1024);
+    CompressedCache::decompress(compressed.data(), compressed.size(), restored.data(), restored.size());
+    EXPECT_EQ(page, restored);
+    EXPECT_TRUE(cache.take(1).empty());
+    EXPECT_EQ(0, cache.get_size());
+
+    // A take between the reservation and the insert cancels it.
+    cache.reserve(2);
+    EXPECT_TRUE(cache.take(2).empty());
+    EXPECT_FALSE(cache.insert(2, page.data()));
+}
+
+
+// NOLINTNEXTLINE
+TEST(CompressedCacheTest, Budget) {
+    std::vector<char> compressed(1024);
+    size_t size = CompressedCache::compress(make_page(1024, 1).data(), 1024, compressed.data(), compressed.size());
+    CompressedCache cache{1024, 3 * size};
+    for (uint64_t page_id = 0; page_id < 5; ++page_id) {
+        cache.reserve(page_id);
+        EXPECT_TRUE(cache.insert(page_id, make_page(1024, 1).data()));
+        EXPECT_LE(cache.get_size(), 3 * size);
+    }
+    // The pages that were evicted first are dropped.
+    EXPECT_EQ(3, cache.get_page_count());
+    EXPECT_TRUE(cache.take(0).empty());
+    EXPECT_TRUE(cache.take(1).empty());
+    EXPECT_FALSE(cache.take(4).empty());
+}
+
+
+// NOLINTNEXTLINE
+TEST(CompressedCacheTest, BufferManager) {
+    uint64_t segment_shift = static_cast<uint64_t>(33) << 48;
+    std::remove("33");
+    {
+        moderndbs::BufferManager buffer_manager{1024, 2};
+        for (uint64_t i = 0; i < 6; ++i) {
+            auto& page = buffer_manager.fix_page(segment_shift | i, true);
+            auto data = make_page(1024, i);
+            std::memcpy(page.get_data(), data.data(), data.size());
+            buffer_manager.unfix_page(page, true);
+        }
+    }
+    moderndbs::BufferManagerOptions options;
+    options.compressed_cache_size = 1 << 20;
+    moderndbs::BufferManager buffer_manager{1024, 2, options};
+    for (uint64_t round = 0; round < 3; ++round) {
+        for (uint64_t i = 0; i < 6; ++i) {
+            auto& page = buffer_manager.fix_page(segment_shift | i, round == 1);
+            EXPECT_EQ(make_page(1024, i + (round == 2)), std::vector<char>(page.get_data(), page.get_data() + 1024));
+            // Dirty pages are written instead of stored.
+            if (round == 1) {
+                auto data = make_page(1024, i + 1);
+                std::memcpy(page.get_data(), data.data(), data.size());
+            }
+            buffer_manager.unfix_page(page, round == 1);
+        }
+    }
+    auto stats = buffer_manager.get_stats();
+    EXPECT_EQ(18, stats.misses);
+    // The second round finds all pages in the compressed tier, the third one
+    // reads them again since their dirty versions were written.
+    EXPECT_EQ(6, stats.compressed_hits);
+    EXPECT_EQ(4 + 2 + 4, stats.compressed_stores);
+    std::remove("33");
+}
+
+}  // namespace
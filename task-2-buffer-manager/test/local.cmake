@@ -6,7 +6,7 @@
 # Files
 # ---------------------------------------------------------------------------
 
-set(TEST_CC test/buffer_manager_test.cc)
+set(TEST_CC test/async_io_test.cc test/buffer_manager_test.cc test/buffer_stats_test.cc test/checksum_test.cc test/compressed_cache_test.cc test/log_manager_test.cc test/recovery_test.cc test/replacement_policy_test.cc test/trace_recorder_test.cc)
 
 # ---------------------------------------------------------------------------
 # Tester
@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "moderndbs/buffer_manager.h"
+#include "moderndbs/log_manager.h"
+
+
+namespace {
+
+using moderndbs::LogManager;
+using moderndbs::LogRecord;
+
+
+// NOLINTNEXTLINE
+TEST(LogManagerTest, UpdateCommitReopen) {
+    std::remove("log_manager_test.log");
+    std::vector<char> page(64, 0);
+    uint64_t first_lsn;
+    {
+        LogManager log{"log_manager_test.log"};
+        auto txn = log.begin();
+        first_lsn = log.log_update(txn, 3, page.data(), 16, "abcd", 4);
+        EXPECT_EQ(first_lsn, LogManager::get_page_lsn(page.data()));
+        EXPECT_EQ(0, std::memcmp(page.data() + 16, "abcd", 4));
+        log.log_update(txn, 3, page.data(), 18, "xy", 2);
+        log.commit(txn);
+        EXPECT_LE(txn.last_lsn, log.get_flushed_lsn());
+        EXPECT_THROW(log.log_update(txn, 3, page.data(), 4, "abcd", 4), std::invalid_argument);
+        // The page checksum follows the page LSN.
+        EXPECT_THROW(log.log_update(txn, 3, page.data(), 8, "abcd", 4), std::invalid_argument);
+    }
+    std::vector<LogRecord> records;
+    std::vector<std::string> befores;
+    std::vector<std::string> afters;
+    LogManager::read("log_manager_test.log", [&](const LogRecord& record) {
+        records.push_back(record);
+        befores.emplace_back(record.get_before(), record.length);
+        afters.emplace_back(record.get_after(), record.length);
+    });
+    ASSERT_EQ(3, records.size());
+    EXPECT_EQ(LogRecord::UPDATE, records[0].type);
+    EXPECT_EQ(first_lsn, records[0].lsn);
+    EXPECT_EQ(0, records[0].prev_lsn);
+    EXPECT_EQ(3, records[0].page_id);
+    EXPECT_EQ(std::string(4, '\0'), befores[0]);
+    EXPECT_EQ("abcd", afters[0]);
+    EXPECT_EQ("cd", befores[1]);
+    EXPECT_EQ("xy", afters[1]);
+    EXPECT_EQ(records[0].lsn, records[1].prev_lsn);
+    EXPECT_EQ(LogRecord::COMMIT, records[2].type);
+    EXPECT_EQ(records[1].lsn, records[2].prev_lsn);
+
+    // A reopened log continues after the last LSN and transaction.
+    {
+        LogManager log{"log_manager_test.log"};
+        EXPECT_EQ(records[2].lsn, log.get_flushed_lsn());
+        auto txn = log.begin();
+        EXPECT_GT(txn.id, records[0].txn);
+        EXPECT_GT(log.log_update(txn, 4, page.data(), 16, "e", 1), records[2].lsn);
+        log.commit(txn);
+    }
+    size_t count = 0;
+    LogManager::read("log_manager_test.log", [&](const LogRecord&) { ++count; });
+    EXPECT_EQ(5, count);
+    std::remove("log_manager_test.log");
+}
+
+
+// NOLINTNEXTLINE
+TEST(LogManagerTest, TornTail) {
+    std::remove("log_manager_test.log");
+    std::vector<char> page(64, 0);
+    {
+        LogManager log{"log_manager_test.log"};
+        auto txn = log.begin();
+        log.log_update(txn, 1, page.data(), 16, "abcd", 4);
+        log.commit(txn);
+    }
+    size_t valid_size = LogManager::read("log_manager_test.log", [](const LogRecord&) {});
+    {
+        std::ofstream file{"log_manager_test.log", std::ios::binary | std::ios::app};
+        file << "a torn record that does not fit";
+    }
+    EXPECT_EQ(valid_size, LogManager::read("log_manager_test.log", [](const LogRecord&) {}));
+    {
+        LogManager log{"log_manager_test.log"};
+        auto txn = log.begin();
+        log.log_update(txn, 1, page.data(), 24, "efgh", 4);
+        log.commit(txn);
+    }
+    size_t count = 0;
+    LogManager::read("log_manager_test.log", [&](const LogRecord&) { ++count; });
+    EXPECT_EQ(4, count);
+    std::remove("log_manager_test.log");
+}
+
+
+// NOLINTNEXTLINE
+TEST(LogManagerTest, MultithreadGroupCommit) {
+    std::remove("log_manager_test.log");
+    constexpr size_t thread_count = 8;
+    constexpr size_t commit_count = 50;
+    {
+        moderndbs::LogManagerOptions options;
+        options.commit_delay = std::chrono::microseconds{1000};
+        // Small buffers make the threads wait for the flusher.
+        options.thread_buffer_size = 1024;
+        LogManager log{"log_manager_test.log", options};
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < thread_count; ++t) {
+            threads.emplace_back([&log, t] {
+                std::vector<char> page(256, 0);
+                for (size_t i = 0; i < commit_count; ++i) {
+                    auto txn = log.begin();
+                    for (size_t j = 0; j < 4; ++j) {
+                        log.log_update(txn, t, page.data(), 16 + 16 * j, "0123456789abcdef", 16);
+                    }
+                    log.commit(txn);
+                    ASSERT_LE(txn.last_lsn, log.get_flushed_lsn());
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        // Commits share syncs.
+        EXPECT_LT(log.get_flush_count(), thread_count * commit_count);
+    }
+    std::vector<uint64_t> lsns;
+    LogManager::read("log_manager_test.log", [&](const LogRecord& record) { lsns.push_back(record.lsn); });
+    std::sort(lsns.begin(), lsns.end());
+    ASSERT_EQ(thread_count * commit_count * 5, lsns.size());
+    for (size_t i = 0; i < lsns.size(); ++i) {
+        EXPECT_EQ(i + 1, lsns[i]);
+    }
+    std::remove("log_manager_test.log");
+}
+
+
+// NOLINTNEXTLINE
+TEST(LogManagerTest, CommitFromNewThreads) {
+    std::remove("log_manager_test.log");
+    moderndbs::LogManagerOptions options;
+    options.thread_buffer_size = 1024;
+    options.flush_interval = std::chrono::milliseconds{1};
+    {
+        LogManager log{"log_manager_test.log", options};
+        // The first append of each thread registers its log while the flusher
+        // may be running, a commit must not return before its record is written.
+        for (size_t i = 0; i < 100; ++i) {
+            uint64_t lsn = 0;
+            std::thread thread([&] {
+                std::vector<char> page(64, 0);
+                auto txn = log.begin();
+                log.log_update(txn, i, page.data(), 16, "abcd", 4);
+                log.commit(txn);
+                lsn = txn.last_lsn;
+            });
+            thread.join();
+            bool found = false;
+            LogManager::read("log_manager_test.log", [&](const LogRecord& record) { found |= record.lsn == lsn; });
+            ASSERT_TRUE(found) << i;
+        }
+    }
+    std::remove("log_manager_test.log");
+}
+
+
+// NOLINTNEXTLINE
+TEST(LogManagerTest, BufferManagerWriteBack) {
+    std::remove("log_manager_test.log");
+    std::remove("27");
+    uint64_t segment_shift = static_cast<uint64_t>(27) << 48;
+    LogManager log{"log_manager_test.log", {1 << 20, std::chrono::microseconds{0}, std::chrono::milliseconds{10000}}};
+    moderndbs::BufferManagerOptions options;
+    options.wal = &log;
+    {
+        moderndbs::BufferManager buffer_manager{1024, 1, options};
+        auto txn = log.begin();
+        auto& page = buffer_manager.fix_page(segment_shift | 1, true);
+        uint64_t lsn = log.log_update(txn, segment_shift | 1, page.get_data(), 16, "abcd", 4);
+        // The update is not committed, so only the write-back flushes it.
+        EXPECT_LT(log.get_flushed_lsn(), lsn);
+        buffer_manager.unfix_page(page, true);
+        auto& page2 = buffer_manager.fix_page(segment_shift | 2, false);
+        buffer_manager.unfix_page(page2, false);
+        EXPECT_GE(log.get_flushed_lsn(), lsn);
+    }
+    std::remove("27");
+    std::remove("log_manager_test.log");
+}
+
+}  // namespace
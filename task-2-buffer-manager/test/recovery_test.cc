@@ -0,0 +1,166 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "moderndbs/buffer_manager.h"
+#include "moderndbs/log_manager.h"
+#include "moderndbs/recovery.h"
+
+
+namespace {
+
+using moderndbs::BufferManager;
+using moderndbs::LogManager;
+
+
+/// Returns the bytes at `offset` of a page after a restart.
+std::string read_page(BufferManager& buffer_manager, uint64_t page_id, size_t offset, size_t length) {
+    auto& page = buffer_manager.fix_page(page_id, false);
+    std::string result{page.get_data() + offset, length};
+    buffer_manager.unfix_page(page, false);
+    return result;
+}
+
+
+// NOLINTNEXTLINE
+TEST(RecoveryTest, RedoUndo) {
+    std::remove("recovery_test.log");
+    std::remove("28");
+    uint64_t segment_shift = static_cast<uint64_t>(28) << 48;
+    {
+        LogManager log{"recovery_test.log"};
+        moderndbs::BufferManagerOptions options;
+        options.wal = &log;
+        BufferManager buffer_manager{1024, 4, options};
+        // A committed update of page 1 whose page is never written.
+        std::vector<char> lost_page(1024, 0);
+        auto winner = log.begin();
+        log.log_update(winner, segment_shift | 1, lost_page.data(), 16, "committed", 9);
+        log.commit(winner);
+        // An update of a loser that reaches the disk with page 2.
+        auto loser = log.begin();
+        auto& page = buffer_manager.fix_page(segment_shift | 2, true);
+        log.log_update(loser, segment_shift | 2, page.get_data(), 16, "first", 5);
+        log.log_update(loser, segment_shift | 2, page.get_data(), 18, "second", 6);
+        buffer_manager.unfix_page(page, true);
+    }
+    {
+        LogManager log{"recovery_test.log"};
+        moderndbs::BufferManagerOptions options;
+        options.wal = &log;
+        BufferManager buffer_manager{1024, 4, options};
+        auto stats = moderndbs::recover(buffer_manager, log, {2});
+        EXPECT_EQ(1, stats.start_lsn);
+        EXPECT_EQ(4, stats.scanned);
+        EXPECT_EQ(1, stats.redone);
+        EXPECT_EQ(2, stats.skipped);
+        EXPECT_EQ(1, stats.losers);
+        EXPECT_EQ(2, stats.undone);
+        EXPECT_EQ("committed", read_page(buffer_manager, segment_shift | 1, 16, 9));
+        EXPECT_EQ(std::string(11, '\0'), read_page(buffer_manager, segment_shift | 2, 16, 11));
+    }
+    {
+        // The restart rolled the loser back and took a checkpoint.
+        LogManager log{"recovery_test.log"};
+        moderndbs::BufferManagerOptions options;
+        options.wal = &log;
+        BufferManager buffer_manager{1024, 4, options};
+        auto stats = moderndbs::recover(buffer_manager, log);
+        EXPECT_EQ(1, stats.scanned);
+        EXPECT_EQ(0, stats.redone);
+        EXPECT_EQ(0, stats.losers);
+        EXPECT_EQ("committed", read_page(buffer_manager, segment_shift | 1, 16, 9));
+    }
+    std::remove("28");
+    std::remove("recovery_test.log");
+}
+
+
+// NOLINTNEXTLINE
+TEST(RecoveryTest, CrashDuringUndo) {
+    std::remove("recovery_test.log");
+    std::remove("29");
+    uint64_t segment_shift = static_cast<uint64_t>(29) << 48;
+    {
+        LogManager log{"recovery_test.log"};
+        std::vector<char> page(1024, 0);
+        auto loser = log.begin();
+        log.log_update(loser, segment_shift | 1, page.data(), 16, "aa", 2);
+        uint64_t second = log.log_update(loser, segment_shift | 1, page.data(), 24, "bb", 2);
+        // The second update was undone before the crash.
+        log.log_compensation(loser, segment_shift | 1, page.data(), 24, "\0\0", 2, second - 1);
+        log.flush(log.get_next_lsn() - 1);
+    }
+    {
+        LogManager log{"recovery_test.log"};
+        moderndbs::BufferManagerOptions options;
+        options.wal = &log;
+        BufferManager buffer_manager{1024, 4, options};
+        auto stats = moderndbs::recover(buffer_manager, log, {1});
+        EXPECT_EQ(3, stats.redone);
+        EXPECT_EQ(1, stats.undone);
+        EXPECT_EQ(std::string(10, '\0'), read_page(buffer_manager, segment_shift | 1, 16, 10));
+    }
+    size_t compensations = 0;
+    size_t ends = 0;
+    LogManager::read("recovery_test.log", [&](const moderndbs::LogRecord& record) {
+        compensations += record.type == moderndbs::LogRecord::COMPENSATION;
+        ends += record.type == moderndbs::LogRecord::END;
+    });
+    EXPECT_EQ(2, compensations);
+    EXPECT_EQ(1, ends);
+    std::remove("29");
+    std::remove("recovery_test.log");
+}
+
+
+// NOLINTNEXTLINE
+TEST(RecoveryTest, CheckpointParallelRedo) {
+    std::remove("recovery_test.log");
+    std::remove("30");
+    uint64_t segment_shift = static_cast<uint64_t>(30) << 48;
+    constexpr uint64_t page_count = 64;
+    {
+        LogManager log{"recovery_test.log"};
+        moderndbs::BufferManagerOptions options;
+        options.wal = &log;
+        BufferManager buffer_manager{1024, 8, options};
+        // Updates before the checkpoint are on disk after it.
+        auto txn = log.begin();
+        auto& page = buffer_manager.fix_page(segment_shift, true);
+        log.log_update(txn, segment_shift, page.get_data(), 16, "old", 3);
+        buffer_manager.unfix_page(page, true);
+        log.commit(txn);
+        moderndbs::checkpoint(buffer_manager, log);
+
+        std::vector<char> lost_page(1024, 0);
+        for (uint64_t i = 1; i <= page_count; ++i) {
+            txn = log.begin();
+            uint64_t value = i * 7;
+            log.log_update(txn, segment_shift | i, lost_page.data(), 16, reinterpret_cast<char*>(&value), sizeof(value));
+            log.commit(txn);
+        }
+    }
+    {
+        LogManager log{"recovery_test.log"};
+        moderndbs::BufferManagerOptions options;
+        options.wal = &log;
+        BufferManager buffer_manager{1024, 8, options};
+        auto stats = moderndbs::recover(buffer_manager, log, {4});
+        EXPECT_LT(1, stats.start_lsn);
+        EXPECT_EQ(1 + 2 * page_count, stats.scanned);
+        EXPECT_EQ(page_count, stats.redone);
+        EXPECT_EQ(0, stats.skipped);
+        EXPECT_EQ("old", read_page(buffer_manager, segment_shift, 16, 3));
+        for (uint64_t i = 1; i <= page_count; ++i) {
+            uint64_t value;
+            std::memcpy(&value, read_page(buffer_manager, segment_shift | i, 16, sizeof(value)).data(), sizeof(value));
+            EXPECT_EQ(i * 7, value);
+        }
+    }
+    std::remove("30");
+    std::remove("recovery_test.log");
+}
+
+}  // namespace
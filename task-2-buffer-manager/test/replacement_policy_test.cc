@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <gtest/gtest.h>
+#include "moderndbs/buffer_manager.h"
+#include "moderndbs/replacement_policy.h"
+
+
+namespace {
+
+using moderndbs::BufferFrame;
+using moderndbs::ReplacementPolicy;
+
+/// Frames for pages 0 to `count - 1`.
+std::unique_ptr<BufferFrame[]> makeFrames(size_t count) {
+    auto frames = std::make_unique<BufferFrame[]>(count);
+    for (size_t i = 0; i < count; ++i) {
+        frames[i].pageid = i;
+    }
+    return frames;
+}
+
+/// Evicts the next frame that `try_evict` accepts and returns its page id,
+/// or -1 when there is none.
+int64_t evict(ReplacementPolicy& policy, const std::function<bool(BufferFrame*)>& try_evict = [](BufferFrame*) { return true; }) {
+    uint64_t promotions = 0;
+    BufferFrame* frame = policy.evict(try_evict, promotions);
+    return frame == nullptr ? -1 : static_cast<int64_t>(frame->pageid);
+}
+
+
+// NOLINTNEXTLINE
+TEST(ReplacementPolicyTest, TwoQ) {
+    auto frames = makeFrames(3);
+    auto policy = ReplacementPolicy::make(ReplacementPolicy::TWO_Q, 3);
+    for (size_t i = 0; i < 3; ++i) {
+        policy->insert(&frames[i]);
+    }
+    EXPECT_TRUE(policy->access(&frames[1]));
+    EXPECT_FALSE(policy->access(&frames[1]));
+    EXPECT_EQ((std::vector<uint64_t>{0, 2}), policy->get_pages(false));
+    EXPECT_EQ(std::vector<uint64_t>{1}, policy->get_pages(true));
+    EXPECT_EQ(0, evict(*policy));
+    EXPECT_EQ(2, evict(*policy));
+    EXPECT_EQ(1, evict(*policy));
+    EXPECT_EQ(-1, evict(*policy));
+}
+
+
+// NOLINTNEXTLINE
+TEST(ReplacementPolicyTest, Clock) {
+    auto frames = makeFrames(3);
+    auto policy = ReplacementPolicy::make(ReplacementPolicy::CLOCK, 3);
+    EXPECT_TRUE(policy->latch_free_access());
+    for (size_t i = 0; i < 3; ++i) {
+        policy->insert(&frames[i]);
+    }
+    // The hand skips page 0 and clears its bit.
+    policy->access(&frames[0]);
+    EXPECT_EQ(1, evict(*policy));
+    EXPECT_EQ((std::vector<uint64_t>{2, 0}), policy->get_pages(false));
+    EXPECT_TRUE(policy->get_pages(true).empty());
+    // New frames are inserted behind the hand.
+    frames[1].pageid = 3;
+    policy->insert(&frames[1]);
+    EXPECT_EQ(2, evict(*policy));
+    EXPECT_EQ(0, evict(*policy));
+    EXPECT_EQ(3, evict(*policy));
+    EXPECT_EQ(-1, evict(*policy));
+}
+
+
+// NOLINTNEXTLINE
+TEST(ReplacementPolicyTest, LruK) {
+    auto frames = makeFrames(3);
+    auto policy = ReplacementPolicy::make(ReplacementPolicy::LRU_K, 3);
+    for (size_t i = 0; i < 3; ++i) {
+        policy->insert(&frames[i]);
+    }
+    EXPECT_TRUE(policy->access(&frames[0]));
+    EXPECT_TRUE(policy->access(&frames[1]));
+    EXPECT_FALSE(policy->access(&frames[0]));
+    // Page 0 was accessed last, but page 1 has the older second to last
+    // access.
+    EXPECT_EQ(std::vector<uint64_t>{2}, policy->get_pages(false));
+    EXPECT_EQ((std::vector<uint64_t>{1, 0}), policy->get_pages(true));
+    EXPECT_EQ(2, evict(*policy));
+    EXPECT_EQ(1, evict(*policy));
+    EXPECT_EQ(0, evict(*policy));
+    EXPECT_EQ(-1, evict(*policy));
+}
+
+
+// NOLINTNEXTLINE
+TEST(ReplacementPolicyTest, Arc) {
+    auto frames = makeFrames(2);
+    auto policy = ReplacementPolicy::make(ReplacementPolicy::ARC, 2);
+    policy->insert(&frames[0]);
+    policy->insert(&frames[1]);
+    EXPECT_EQ(0, evict(*policy));
+    // Page 0 is remembered, loading it again counts as a repeated access.
+    policy->insert(&frames[0]);
+    EXPECT_EQ(std::vector<uint64_t>{1}, policy->get_pages(false));
+    EXPECT_EQ(std::vector<uint64_t>{0}, policy->get_pages(true));
+    // The recency list grew its target, so page 0 goes first now.
+    EXPECT_EQ(0, evict(*policy));
+    EXPECT_EQ(1, evict(*policy));
+    EXPECT_EQ(-1, evict(*policy));
+}
+
+
+// NOLINTNEXTLINE
+TEST(ReplacementPolicyTest, RejectedFrames) {
+    for (auto kind : {ReplacementPolicy::TWO_Q, ReplacementPolicy::CLOCK, ReplacementPolicy::LRU_K, ReplacementPolicy::ARC}) {
+        auto frames = makeFrames(4);
+        auto policy = ReplacementPolicy::make(kind, 4);
+        for (size_t i = 0; i < 4; ++i) {
+            policy->insert(&frames[i]);
+            policy->access(&frames[i]);
+        }
+        policy->access(&frames[2]);
+        auto skipFixed = [](BufferFrame* frame) { return frame->pageid % 2 == 1; };
+        std::vector<int64_t> evicted{evict(*policy, skipFixed), evict(*policy, skipFixed)};
+        std::sort(evicted.begin(), evicted.end());
+        EXPECT_EQ((std::vector<int64_t>{1, 3}), evicted) << kind;
+        EXPECT_EQ(-1, evict(*policy, skipFixed)) << kind;
+        EXPECT_EQ(2, policy->size()) << kind;
+        std::vector<BufferFrame*> resident;
+        policy->collect(10, resident);
+        EXPECT_EQ(2, resident.size()) << kind;
+    }
+}
+
+
+
+// NOLINTNEXTLINE
+TEST(ReplacementPolicyTest, Remove) {
+    for (auto kind : {ReplacementPolicy::TWO_Q, ReplacementPolicy::CLOCK, ReplacementPolicy::LRU_K, ReplacementPolicy::ARC}) {
+        auto frames = makeFrames(4);
+        auto policy = ReplacementPolicy::make(kind, 4);
+        for (size_t i = 0; i < 4; ++i) {
+            policy->insert(&frames[i]);
+        }
+        policy->access(&frames[1]);
+        policy->access(&frames[2]);
+        policy->access(&frames[3]);
+        policy->remove(&frames[0]);
+        policy->remove(&frames[2]);
+        EXPECT_EQ(2, policy->size()) << kind;
+        std::vector<int64_t> evicted{evict(*policy), evict(*policy)};
+        std::sort(evicted.begin(), evicted.end());
+        EXPECT_EQ((std::vector<int64_t>{1, 3}), evicted) << kind;
+        EXPECT_EQ(-1, evict(*policy)) << kind;
+    }
+}
+
+}  // namespace
@@ -0,0 +1,117 @@
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+#include "moderndbs/buffer_manager.h"
+#include "moderndbs/trace_recorder.h"
+
+
+namespace {
+
+using moderndbs::TraceRecord;
+using moderndbs::TraceRecorder;
+
+
+// NOLINTNEXTLINE
+TEST(TraceRecorderTest, BufferManager) {
+    uint64_t segment_shift = static_cast<uint64_t>(21) << 48;
+    {
+        moderndbs::BufferManagerOptions options;
+        options.trace_file = "trace_recorder_test.trace";
+        moderndbs::BufferManager buffer_manager{1024, 2, options};
+        auto& page = buffer_manager.fix_page(segment_shift | 1, true);
+        buffer_manager.unfix_page(page, true);
+        auto& page2 = buffer_manager.fix_page(segment_shift | 2, false);
+        buffer_manager.unfix_page(page2, false);
+        uint64_t version;
+        buffer_manager.fix_page_optimistic(segment_shift | 1, version);
+    }
+    auto trace = TraceRecorder::read("trace_recorder_test.trace");
+    std::remove("trace_recorder_test.trace");
+    ASSERT_EQ(5, trace.size());
+    EXPECT_EQ(TraceRecord::FIX, trace[0].event);
+    EXPECT_EQ(TraceRecord::EXCLUSIVE, trace[0].mode);
+    EXPECT_EQ(TraceRecord::UNFIX, trace[1].event);
+    EXPECT_TRUE(trace[1].dirty);
+    EXPECT_EQ(TraceRecord::SHARED, trace[2].mode);
+    EXPECT_FALSE(trace[3].dirty);
+    EXPECT_EQ(TraceRecord::OPTIMISTIC, trace[4].mode);
+    std::vector<uint64_t> page_ids;
+    for (size_t i = 0; i < trace.size(); ++i) {
+        page_ids.push_back(trace[i].page_id & ~segment_shift);
+        EXPECT_EQ(trace[0].thread, trace[i].thread);
+        if (i > 0) {
+            EXPECT_LE(trace[i - 1].timestamp, trace[i].timestamp);
+        }
+    }
+    EXPECT_EQ((std::vector<uint64_t>{1, 1, 2, 2, 1}), page_ids);
+}
+
+
+// NOLINTNEXTLINE
+TEST(TraceRecorderTest, MultithreadRingWrap) {
+    constexpr uint64_t record_count = 1000;
+    {
+        // Far more records than fit into the ring.
+        TraceRecorder recorder{"trace_recorder_test.trace", 4, 2};
+        std::vector<std::thread> threads;
+        for (uint64_t t = 0; t < 4; ++t) {
+            threads.emplace_back([&recorder, t] {
+                for (uint64_t i = 0; i < record_count; ++i) {
+                    recorder.record(TraceRecord::FIX, (t << 32) | i, TraceRecord::SHARED);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        EXPECT_EQ(4 * record_count, recorder.get_record_count());
+        EXPECT_FALSE(recorder.has_failed());
+    }
+    auto trace = TraceRecorder::read("trace_recorder_test.trace");
+    std::remove("trace_recorder_test.trace");
+    ASSERT_EQ(4 * record_count, trace.size());
+    // The records of every thread are complete and in order.
+    std::vector<uint64_t> next(4, 0);
+    for (auto& record : trace) {
+        uint64_t t = record.page_id >> 32;
+        ASSERT_LT(t, 4);
+        EXPECT_EQ(next[t]++, record.page_id & 0xFFFFFFFF);
+    }
+}
+
+
+// NOLINTNEXTLINE
+TEST(TraceRecorderTest, Replay) {
+    std::vector<TraceRecord> trace;
+    auto fix = [&](uint64_t page_id) {
+        trace.push_back({page_id, 0, 0, TraceRecord::FIX, TraceRecord::SHARED, false, 0});
+        trace.push_back({page_id, 0, 0, TraceRecord::UNFIX, TraceRecord::SHARED, false, 0});
+    };
+    for (uint64_t round = 0; round < 3; ++round) {
+        for (uint64_t page_id = 0; page_id < 3; ++page_id) {
+            fix(page_id);
+        }
+    }
+    auto stats = moderndbs::replay_trace(trace, 3, moderndbs::ReplacementPolicy::TWO_Q);
+    EXPECT_EQ(6, stats.hits);
+    EXPECT_EQ(3, stats.misses);
+    EXPECT_EQ(3, stats.promotions);
+    EXPECT_EQ(0, stats.evictions);
+    // A cyclic scan over more pages than fit never hits with 2Q or LRU.
+    stats = moderndbs::replay_trace(trace, 2, moderndbs::ReplacementPolicy::TWO_Q);
+    EXPECT_EQ(0, stats.hits);
+    EXPECT_EQ(7, stats.evictions);
+
+    // Fixed pages are not evicted, a miss without a free frame is not cached.
+    trace.clear();
+    trace.push_back({1, 0, 0, TraceRecord::FIX, TraceRecord::EXCLUSIVE, false, 0});
+    fix(2);
+    fix(1);
+    stats = moderndbs::replay_trace(trace, 1, moderndbs::ReplacementPolicy::CLOCK);
+    EXPECT_EQ(1, stats.hits);
+    EXPECT_EQ(2, stats.misses);
+    EXPECT_EQ(0, stats.evictions);
+}
+
+}  // namespace
@@ -6,12 +6,15 @@
 # Sources
 # ---------------------------------------------------------------------------
 
-set(TOOLS_SRC)
+set(TOOLS_SRC tools/trace_replay.cc)
 
 # ---------------------------------------------------------------------------
 # Executables
 # ---------------------------------------------------------------------------
 
+add_executable(trace_replay tools/trace_replay.cc)
+target_link_libraries(trace_replay moderndbs Threads::Threads)
+
 # ---------------------------------------------------------------------------
 # Linting
 # ---------------------------------------------------------------------------
@@ -0,0 +1,144 @@
+#include <cmath>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "moderndbs/trace_recorder.h"
+
+
+using namespace std::literals::string_view_literals;
+
+
+static const std::pair<std::string_view, moderndbs::ReplacementPolicy::Kind> policies[] = {
+    {"2q"sv, moderndbs::ReplacementPolicy::TWO_Q},
+    {"clock"sv, moderndbs::ReplacementPolicy::CLOCK},
+    {"lru-k"sv, moderndbs::ReplacementPolicy::LRU_K},
+    {"arc"sv, moderndbs::ReplacementPolicy::ARC},
+};
+
+
+static void usage(const char* argv0) {
+    std::cerr << "Usage: " << argv0 << " [--help] print|replay [<options>]" << std::endl;
+    std::cerr << R"(
+Options for print:
+    print <trace_file>
+
+    "print" prints all records of <trace_file>, which was written by a
+    BufferManager with BufferManagerOptions::trace_file, one per line.
+
+Options for replay:
+    replay <trace_file> <min_pages> <max_pages> [<steps> [<policy>]]
+
+    "replay" replays the fixes of <trace_file> on pools of <steps> (default 8)
+    sizes between <min_pages> and <max_pages>, growing geometrically, and
+    prints the hit ratio of every size as CSV. <policy> is one of 2q, clock,
+    lru-k, arc or all (default).
+)";
+}
+
+
+static bool parse_size(const char* str, size_t& value) {
+    std::string s(str);
+    size_t pos = 0;
+    try {
+        value = std::stoull(s, &pos);
+    } catch (std::exception&) {
+        return false;
+    }
+    return pos == s.size();
+}
+
+
+static int mode_print(int argc, const char* argv[]) {
+    using TraceRecord = moderndbs::TraceRecord;
+    if (argc != 3) {
+        usage(argv[0]);
+        return 2;
+    }
+    static const char* modes[] = {"shared", "exclusive", "optimistic"};
+    for (auto& record : moderndbs::TraceRecorder::read(argv[2])) {
+        std::cout << record.timestamp << ' ' << record.thread << ' '
+            << (record.event == TraceRecord::FIX ? "fix " : "unfix ")
+            << record.page_id << ' ' << modes[record.mode % 3]
+            << (record.dirty ? " dirty" : "") << '\n';
+    }
+    std::cout.flush();
+    return 0;
+}
+
+
+static int mode_replay(int argc, const char* argv[]) {
+    if (argc < 5 || argc > 7) {
+        usage(argv[0]);
+        return 2;
+    }
+    size_t min_pages;
+    size_t max_pages;
+    size_t steps = 8;
+    if (!parse_size(argv[3], min_pages) || !parse_size(argv[4], max_pages)
+        || (argc >= 6 && !parse_size(argv[5], steps))
+        || min_pages == 0 || max_pages < min_pages || steps == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+    std::vector<std::pair<std::string_view, moderndbs::ReplacementPolicy::Kind>> selected;
+    std::string_view policy_name = argc == 7 ? argv[6] : "all"sv;
+    for (auto& policy : policies) {
+        if (policy_name == "all"sv || policy_name == policy.first) {
+            selected.push_back(policy);
+        }
+    }
+    if (selected.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    auto trace = moderndbs::TraceRecorder::read(argv[2]);
+    std::cout << "policy,pages,hits,misses,hit_ratio\n";
+    size_t last_pages = 0;
+    for (size_t step = 0; step < steps; ++step) {
+        double fraction = steps == 1 ? 1.0 : static_cast<double>(step) / static_cast<double>(steps - 1);
+        auto pages = static_cast<size_t>(std::llround(
+            static_cast<double>(min_pages) * std::pow(static_cast<double>(max_pages) / static_cast<double>(min_pages), fraction)
+        ));
+        // Small ranges round several steps to the same size.
+        if (pages == last_pages) {
+            continue;
+        }
+        last_pages = pages;
+        for (auto& policy : selected) {
+            auto stats = moderndbs::replay_trace(trace, pages, policy.second);
+            uint64_t fixes = stats.hits + stats.misses;
+            std::cout << policy.first << ',' << pages << ',' << stats.hits << ',' << stats.misses << ','
+                << (fixes == 0 ? 0.0 : static_cast<double>(stats.hits) / static_cast<double>(fixes)) << '\n';
+        }
+    }
+    std::cout.flush();
+    return 0;
+}
+
+
+int main(int argc, const char* argv[]) {
+    if (argc <= 2) {
+        usage(argv[0]);
+        return 2;
+    }
+    std::string_view mode{argv[1]};
+    try {
+        if (mode == "print"sv) {
+            return mode_print(argc, argv);
+        } else if (mode == "replay"sv) {
+            return mode_replay(argc, argv);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+    } catch (std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -9,7 +9,6 @@
 #include <cassert>
 #include <iostream>
 #include <vector>
-#include <list>
 
 namespace moderndbs {
 
@@ -46,8 +45,24 @@ struct SlottedPage {
         /// Constructor
         Slot();
 
+        /// Whether the slot holds no record and can be reused.
+        bool isEmpty() const { return value == 0; }
+        /// The offset of the record within the page.
+        uint32_t getOffset() const { return static_cast<uint32_t>(value << 16 >> 40); }
+        /// The size of the record.
+        uint32_t getSize() const { return static_cast<uint32_t>(value << 40 >> 40); }
+        /// Points the slot to a record on this page.
+        void setRecord(uint32_t offset, uint32_t size);
+        /// Moves the record, keeping the T and S bits.
+        void setOffset(uint32_t offset);
+
         /// The slot value
         /// c.f. chapter 3 page 13
+        /// - 8 bit T, 0xFF when the record is on this page
+        /// - 8 bit S
+        /// - 24 bit offset
+        /// - 24 bit length
+        /// A value of 0 marks an empty slot.
         uint64_t value;
     };
 
@@ -56,21 +71,46 @@ struct SlottedPage {
     explicit SlottedPage(uint32_t page_size);
 
     /// Compact the page.
+    /// Slides all records towards the end of the page in one pass over the
+    /// slots sorted by offset, so the free space becomes contiguous. Empty
+    /// slots at the end of the slot array are released as well.
     /// @param[in] page_size    The size of a buffer frame.
     void compactify(uint32_t page_size);
 
-    Slot* getSlot(uint16_t slotId);
+    /// Returns the slot array, which starts right after the page header.
+    Slot* getSlots() { return reinterpret_cast<Slot*>(reinterpret_cast<char*>(this) + sizeof(SlottedPage)); }
+
+    /// Returns a slot in constant time.
+    Slot* getSlot(uint16_t slotId) { return &getSlots()[slotId]; }
+
+    /// Returns the space between the slot array and the data, which a new
+    /// record and its slot can use without compactification.
+    uint32_t getContiguousFreeSpace() const {
+        return header.data_start - static_cast<uint32_t>(sizeof(SlottedPage) + header.slot_count * sizeof(Slot));
+    }
 
+    /// Returns the space a new record of `size` bytes needs, including a new
+    /// slot when there is no empty one.
+    uint32_t getRequiredSpace(uint32_t size) const {
+        return size + (header.first_free_slot == header.slot_count ? static_cast<uint32_t>(sizeof(Slot)) : 0);
+    }
+
+    /// Stores a new record of `size` bytes in the first empty slot, or in a
+    /// new one. The contiguous free space must suffice.
     TID addNewEntry(uint32_t size);
 
+    /// Removes the record of a slot and empties the slot.
+    void erase(uint16_t slotId);
+
     /// The header.
     /// Note that the slotted page itself should reside on the buffer frame!
     /// DO NOT allocate heap objects for a slotted page but instead reinterpret_cast BufferFrame.get_data()!
     /// This is also the reason why the constructor and compactify require the actual page size as argument.
     /// (The slotted page itself does not know how large it is)
+    /// The slot array follows directly, then the free space and at the end
+    /// of the page the records, which grow towards the slots.
     Header header;
 
-    std:: list<Slot*> slots;
     uint64_t pageId;
 };
 
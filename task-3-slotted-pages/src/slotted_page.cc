@@ -3,7 +3,6 @@
 #include <cstring>
 #include <vector>
 #include <algorithm>
-#include <list>
 #include <bitset>
 #include "moderndbs/buffer_manager.h"
 
@@ -20,73 +19,93 @@ TID::TID(uint64_t page, uint16_t slot) {
 }
 
 SlottedPage::Header::Header(uint32_t page_size) {
-    this->first_free_slot = 1;
+    this->first_free_slot = 0;
     this->data_start = page_size;
-    this->free_space = page_size - sizeof(header);
+    this->free_space = page_size - sizeof(SlottedPage);
     this->slot_count = 0;
     this->pageSize = page_size;
 }
 
-SlottedPage::Slot::Slot() {
+SlottedPage::Slot::Slot() : value(0) {
 }
 
-SlottedPage::SlottedPage(uint32_t page_size) : header(page_size) {
-    this->header = Header(page_size);
-
+void SlottedPage::Slot::setRecord(uint32_t offset, uint32_t size) {
+    uint64_t t = 0xFF;
+    value = (t << 56) | (uint64_t{offset} << 40 >> 16) | (uint64_t{size} << 40 >> 40);
 }
 
-void SlottedPage::compactify(uint32_t page_size) {
-
+SlottedPage::SlottedPage(uint32_t page_size) : header(page_size), pageId(0) {
 }
 
-moderndbs::SlottedPage::Slot* SlottedPage::getSlot(uint16_t slotId){
-    std::list<Slot *>::iterator it = slots.begin();
-    std::advance(it, slotId-1);
-   return *it;
+void SlottedPage::Slot::setOffset(uint32_t offset) {
+    value = (value >> 48 << 48) | (uint64_t{offset} << 40 >> 16) | (value << 40 >> 40);
 }
 
-TID SlottedPage::addNewEntry(uint32_t size){
-    uint64_t t= ~0 ;
-    uint64_t s = 0;
-    uint64_t offset = header.data_start - size;
-    uint64_t length = size;
-    header.data_start = offset;
-    header.slot_count++;
-
-
-    uint64_t slotValue = 0;
-    slotValue += t << 56;
-    slotValue += s << 56 >> 8;
-    slotValue += (offset << 40 >> 16);
-    slotValue += (length <<40 >>40);
-
-    Slot newSlot=Slot();
-    newSlot.value = slotValue;
-
-    if(header.first_free_slot == header.slot_count){
-        slots.push_back(&newSlot);
-    }else {
-        std::list<Slot *>::iterator it = slots.begin();
-        std::advance(it, header.first_free_slot);
-        slots.insert(it, &newSlot);
+void SlottedPage::compactify(uint32_t page_size) {
+    // Records that lie at higher offsets move first, so no record is
+    // overwritten before it moved and no copy of the page is needed.
+    Slot* slots = getSlots();
+    std::vector<uint16_t> order;
+    order.reserve(header.slot_count);
+    for(uint16_t slotId = 0; slotId < header.slot_count; slotId++){
+        if(!slots[slotId].isEmpty()){
+            order.push_back(slotId);
+        }
+    }
+    std::sort(order.begin(), order.end(), [&](uint16_t a, uint16_t b) {
+        return slots[a].getOffset() > slots[b].getOffset();
+    });
+    char* data = reinterpret_cast<char*>(this);
+    uint32_t end = page_size;
+    for(uint16_t slotId : order){
+        Slot& slot = slots[slotId];
+        end -= slot.getSize();
+        if(end != slot.getOffset()){
+            std::memmove(data + end, data + slot.getOffset(), slot.getSize());
+            slot.setOffset(end);
+        }
     }
+    header.data_start = end;
 
-    header.free_space = header.data_start - sizeof(slots) -sizeof(header);
-
-    TID newId = TID(pageId , header.first_free_slot);
-    bool foundEmpty = false;
-    size_t freeSLot =0 ;
-    for(Slot * l : slots){
-      if(l == nullptr){
-          freeSLot++;
-          foundEmpty = true;
-          header.first_free_slot=freeSLot;
-      }
+    while(header.slot_count > 0 && slots[header.slot_count - 1].isEmpty()){
+        header.slot_count--;
+        header.free_space += sizeof(Slot);
     }
+    header.first_free_slot = std::min(header.first_free_slot, header.slot_count);
+}
 
-    if(!foundEmpty){
-        header.first_free_slot= slots.size();
+TID SlottedPage::addNewEntry(uint32_t size){
+    // Reuse an empty slot, or append one to the slot array.
+    uint16_t slotId = header.first_free_slot;
+    bool newSlot = slotId == header.slot_count;
+    uint32_t required = size + (newSlot ? sizeof(Slot) : 0);
+    assert(required <= getContiguousFreeSpace());
+
+    header.data_start -= size;
+    if(newSlot){
+        header.slot_count++;
     }
+    header.free_space -= required;
+    getSlot(slotId)->setRecord(header.data_start, size);
+
+    Slot* slots = getSlots();
+    do {
+        header.first_free_slot++;
+    } while(header.first_free_slot < header.slot_count && !slots[header.first_free_slot].isEmpty());
+
+    return TID(pageId, slotId);
+}
 
-    return newId;
+void SlottedPage::erase(uint16_t slotId){
+    Slot* slot = getSlot(slotId);
+    assert(slotId < header.slot_count && !slot->isEmpty());
+    header.free_space += slot->getSize();
+    // The lowest record can be released right away, others on compactify.
+    if(slot->getOffset() == header.data_start){
+        header.data_start += slot->getSize();
+    }
+    slot->value = 0;
+    if(slotId < header.first_free_slot){
+        header.first_free_slot = slotId;
+    }
 }
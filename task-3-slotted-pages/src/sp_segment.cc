@@ -22,30 +22,40 @@ SPSegment::SPSegment(uint16_t segment_id, BufferManager& buffer_manager, SchemaS
 }
 
 TID SPSegment::allocate(uint32_t size) {
-    std::pair<bool, uint64_t > pair = fsi.find(size);
+    // A new record may also need a new slot.
+    std::pair<bool, uint64_t > pair = fsi.find(size + static_cast<uint32_t>(sizeof(SlottedPage::Slot)));
     if(pair.first){
-        BufferFrame& frame=buffer_manager->fix_page((segment_id << 48) + pair.second , true);
+        BufferFrame& frame=buffer_manager->fix_page((uint64_t{segment_id} << 48) + pair.second , true);
         SlottedPage * page = reinterpret_cast<SlottedPage *>(frame.get_data());
-        std:: cout << pair.second <<std::endl;
-        TID id= page->addNewEntry(size);
-        buffer_manager->unfix_page(frame, true);
-        fsi.update(pair.second, page->header.free_space);
-        return id;
-    }else {
-        uint64_t pageId = schema.increment_sp_count() ;
-        BufferFrame& frame=buffer_manager->fix_page((segment_id << 48) + pageId , true);
-
-        SlottedPage * page = new (frame.get_data()) SlottedPage(buffer_manager->get_page_size());
-        page->pageId=pageId;
-        //fsi.addNewPage(pageId);
-        TID id=page->addNewEntry(size);
-
-
-        std:: cout << pageId << std::endl;
-        buffer_manager->unfix_page(frame, true);
-        fsi.update(pageId, page->header.free_space);
-        return id;
+        uint32_t required = page->getRequiredSpace(size);
+        // The inventory tracks the space after compactification, which may
+        // still be fragmented.
+        if(required <= page->header.free_space){
+            if(required > page->getContiguousFreeSpace()){
+                page->compactify(buffer_manager->get_page_size());
+            }
+            TID id= page->addNewEntry(size);
+            uint32_t freeSpace = page->header.free_space;
+            buffer_manager->unfix_page(frame, true);
+            fsi.update(pair.second, freeSpace);
+            return id;
+        }
+        // Correct the inventory so that later allocations skip this page.
+        uint32_t freeSpace = page->header.free_space;
+        buffer_manager->unfix_page(frame, false);
+        fsi.update(pair.second, freeSpace);
     }
+    uint64_t pageId = schema.increment_sp_count() ;
+    BufferFrame& frame=buffer_manager->fix_page((uint64_t{segment_id} << 48) + pageId , true);
+
+    SlottedPage * page = new (frame.get_data()) SlottedPage(buffer_manager->get_page_size());
+    page->pageId=pageId;
+    //fsi.addNewPage(pageId);
+    TID id=page->addNewEntry(size);
+    uint32_t freeSpace = page->header.free_space;
+    buffer_manager->unfix_page(frame, true);
+    fsi.update(pageId, freeSpace);
+    return id;
 }
 
 uint32_t SPSegment::read(TID tid, std::byte *record, uint32_t capacity) const {
@@ -220,5 +230,12 @@ void SPSegment::resize(TID tid, uint32_t new_size) {
 }
 
 void SPSegment::erase(TID tid) {
-    // TODO: add your implementation here
+    uint64_t pageId = tid.value >> 16;
+    BufferFrame& frame=buffer_manager->fix_page((uint64_t{segment_id} << 48) + pageId , true);
+    SlottedPage * page = reinterpret_cast<SlottedPage *>(frame.get_data());
+    uint16_t slotId= tid.value << 48 >> 48;
+    page->erase(slotId);
+    uint32_t freeSpace = page->header.free_space;
+    buffer_manager->unfix_page(frame, true);
+    fsi.update(pageId, freeSpace);
 }
@@ -3,8 +3,10 @@
 #include <cstdint>
 #include <cstring>
 #include <exception>
+#include <new>
 #include <utility>
 #include <random>
+#include <string>
 #include <vector>
 #include <gtest/gtest.h>
 #include "moderndbs/segment.h"
@@ -202,6 +204,61 @@ TEST(SegmentTest, SchemaSerialiseTPCHLight) {
     EXPECT_EQ(schema_2->tables[2].primary_key[0], "r_regionkey");
 }
 
+// NOLINTNEXTLINE
+TEST(SegmentTest, SlottedPageSlotArray) {
+    std::vector<char> data(1024, 0);
+    auto* page = new (data.data()) moderndbs::SlottedPage(1024);
+    page->pageId = 7;
+    for (uint16_t i = 0; i < 5; ++i) {
+        auto tid = page->addNewEntry(100);
+        EXPECT_EQ(moderndbs::TID(7, i).value, tid.value);
+    }
+    // The slots live in the page right after the header.
+    auto* slots = reinterpret_cast<moderndbs::SlottedPage::Slot*>(data.data() + sizeof(moderndbs::SlottedPage));
+    EXPECT_EQ(&slots[3], page->getSlot(3));
+    EXPECT_EQ(1024 - 400, page->getSlot(3)->getOffset());
+    EXPECT_EQ(100, page->getSlot(3)->getSize());
+    EXPECT_EQ(1024 - sizeof(moderndbs::SlottedPage) - 5 * (100 + sizeof(moderndbs::SlottedPage::Slot)), page->header.free_space);
+    EXPECT_EQ(page->header.free_space, page->getContiguousFreeSpace());
+
+    // An empty slot is reused before the slot array grows.
+    page->getSlot(2)->value = 0;
+    page->header.first_free_slot = 2;
+    EXPECT_EQ(moderndbs::TID(7, 2).value, page->addNewEntry(50).value);
+    EXPECT_EQ(5, page->header.slot_count);
+    EXPECT_EQ(5, page->header.first_free_slot);
+}
+
+// NOLINTNEXTLINE
+TEST(SegmentTest, SlottedPageCompactify) {
+    std::vector<char> data(1024, 0);
+    auto* page = new (data.data()) moderndbs::SlottedPage(1024);
+    for (uint16_t i = 0; i < 6; ++i) {
+        page->addNewEntry(100);
+        std::memset(data.data() + page->getSlot(i)->getOffset(), 'a' + i, 100);
+    }
+    // Holes in the middle only count as free space.
+    page->erase(1);
+    page->erase(3);
+    EXPECT_EQ(1024 - sizeof(moderndbs::SlottedPage) - 6 * sizeof(moderndbs::SlottedPage::Slot) - 400, page->header.free_space);
+    EXPECT_EQ(page->header.free_space - 200, page->getContiguousFreeSpace());
+
+    page->compactify(1024);
+    EXPECT_EQ(page->header.free_space, page->getContiguousFreeSpace());
+    EXPECT_EQ(1024 - 400, page->header.data_start);
+    for (uint16_t i : {0, 2, 4, 5}) {
+        auto* slot = page->getSlot(i);
+        EXPECT_EQ(100, slot->getSize());
+        EXPECT_EQ(std::string(100, 'a' + i), std::string(data.data() + slot->getOffset(), 100));
+    }
+    // Empty slots at the end are released.
+    page->erase(5);
+    page->compactify(1024);
+    EXPECT_EQ(5, page->header.slot_count);
+    EXPECT_EQ(1, page->header.first_free_slot);
+    EXPECT_EQ(page->header.free_space, page->getContiguousFreeSpace());
+}
+
 // NOLINTNEXTLINE
 TEST(SegmentTest, SPRecordSingleAllocations) {
     auto schema = getTPCHSchemaLight();
@@ -15,11 +15,31 @@ public:
     /// File mode (read or write)
     enum Mode { READ, WRITE };
 
+    /// How blocks move between memory, the OS page cache and the disk.
+    enum IOMode {
+        /// Blocks go through the page cache and every write is durable when
+        /// `write_block()` returns (O_SYNC).
+        SYNC,
+        /// Blocks go through the page cache, writes only become durable with
+        /// `sync()`.
+        BUFFERED,
+        /// Blocks bypass the page cache (O_DIRECT). Offsets, sizes and block
+        /// memory must be multiples of `DIRECT_ALIGNMENT`. Writes only become
+        /// durable with `sync()`.
+        DIRECT
+    };
+
+    /// Alignment of offsets, sizes and block memory in `DIRECT` mode.
+    static constexpr size_t DIRECT_ALIGNMENT = 4096;
+
     virtual ~File() = default;
 
     /// Returns the `Mode` this file was opened with.
     virtual Mode get_mode() const = 0;
 
+    /// Returns the `IOMode` this file was opened with.
+    virtual IOMode get_io_mode() const = 0;
+
     /// Returns the current size of the file in bytes.
     virtual size_t size() const = 0;
 
@@ -55,13 +75,20 @@ public:
     /// @param[in] size   The size of the block.
     virtual void write_block(const char* block, size_t offset, size_t size) = 0;
 
+    /// Makes all blocks written so far durable, without flushing metadata
+    /// that is not needed to read them back (fdatasync).
+    /// Is thread-safe w.r.t concurrent calls to `read_block()` and
+    /// `write_block()`.
+    virtual void sync() = 0;
+
     /// Opens a file with the given mode. Existing files are never overwritten.
     /// @param[in] filename Path to the file.
     /// @param[in] mode     `Mode` that should be used to open the file.
-    static std::unique_ptr<File> open_file(const char* filename, Mode mode);
+    /// @param[in] io_mode  `IOMode` that should be used to open the file.
+    static std::unique_ptr<File> open_file(const char* filename, Mode mode, IOMode io_mode = SYNC);
 
-    /// Opens a temporary file in `WRITE` mode. The file will be deleted
-    /// automatically after use.
+    /// Opens a temporary file in `WRITE` mode with `IOMode` `BUFFERED`. The
+    /// file will be deleted automatically after use.
     static std::unique_ptr<File> make_temporary_file();
 };
 
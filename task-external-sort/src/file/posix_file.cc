@@ -24,6 +24,7 @@ class PosixFile
 : public File {
 private:
     Mode mode;
+    IOMode io_mode;
     int fd;
     size_t cached_size;
 
@@ -36,19 +37,39 @@ private:
     }
 
 public:
-    PosixFile(Mode mode, int fd, size_t size) : mode(mode), fd(fd), cached_size(size) {}
-
-    PosixFile(const char* filename, Mode mode) : mode(mode) {
+    PosixFile(Mode mode, IOMode io_mode, int fd, size_t size)
+    : mode(mode), io_mode(io_mode), fd(fd), cached_size(size) {}
+
+    PosixFile(const char* filename, Mode mode, IOMode io_mode) : mode(mode), io_mode(io_mode) {
+        int flags = 0;
+        switch (io_mode) {
+            case SYNC:
+                flags = O_SYNC;
+                break;
+            case BUFFERED:
+                break;
+            case DIRECT:
+#ifdef O_DIRECT
+                flags = O_DIRECT;
+#endif
+                break;
+        }
         switch (mode) {
             case READ:
-                fd = ::open(filename, O_RDONLY | O_SYNC);
+                fd = ::open(filename, O_RDONLY | flags);
                 break;
             case WRITE:
-                fd = ::open(filename, O_RDWR | O_CREAT | O_SYNC, 0666);
+                fd = ::open(filename, O_RDWR | O_CREAT | flags, 0666);
         }
         if (fd < 0) {
             throw_errno();
         }
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+        if (io_mode == DIRECT && ::fcntl(fd, F_NOCACHE, 1) < 0) {
+            ::close(fd);
+            throw_errno();
+        }
+#endif
         cached_size = read_size();
     }
 
@@ -63,6 +84,10 @@ public:
         return mode;
     }
 
+    IOMode get_io_mode() const override {
+        return io_mode;
+    }
+
     size_t size() const override {
         return cached_size;
     }
@@ -118,11 +143,21 @@ public:
             total_bytes_written += static_cast<size_t>(bytes_written);
         }
     }
+
+    void sync() override {
+#ifdef __APPLE__
+        if (::fsync(fd) < 0) {
+#else
+        if (::fdatasync(fd) < 0) {
+#endif
+            throw_errno();
+        }
+    }
 };
 
 
-std::unique_ptr<File> File::open_file(const char* filename, Mode mode) {
-    return std::make_unique<PosixFile>(filename, mode);
+std::unique_ptr<File> File::open_file(const char* filename, Mode mode, IOMode io_mode) {
+    return std::make_unique<PosixFile>(filename, mode, io_mode);
 }
 
 
@@ -136,7 +171,7 @@ std::unique_ptr<File> File::make_temporary_file() {
         ::close(fd);
         throw_errno();
     }
-    return std::make_unique<PosixFile>(File::WRITE, fd, 0);
+    return std::make_unique<PosixFile>(File::WRITE, File::BUFFERED, fd, 0);
 }
 
 }  // namespace moderndbs
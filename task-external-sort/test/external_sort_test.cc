@@ -56,6 +56,10 @@ public:
         return mode;
     }
 
+    IOMode get_io_mode() const override {
+        return BUFFERED;
+    }
+
     size_t size() const override {
         return file_content.size();
     }
@@ -83,6 +87,8 @@ public:
         }
         std::memcpy(file_content.data() + offset, block, size);
     }
+
+    void sync() override {}
 };
 
 }  // namespace moderndbs
@@ -101,7 +101,8 @@ static int mode_generate(int argc, const char* argv[]) {
             return 2;
         }
     }
-    auto file = File::open_file(filename, File::WRITE);
+    // Write through the page cache and make the file durable once at the end.
+    auto file = File::open_file(filename, File::WRITE, File::BUFFERED);
     file->resize(count * sizeof(uint64_t));
     if (random) {
         std::mt19937_64 engine{0};
@@ -110,6 +111,7 @@ static int mode_generate(int argc, const char* argv[]) {
     } else {
         write_values(*file, count, [](size_t i, size_t count) { return count - i; });
     }
+    file->sync();
     return 0;
 }
 
@@ -158,10 +160,11 @@ int mode_sort(int argc, const char* argv[]) {
         }
     }
     auto input_file = File::open_file(argv[2], File::READ);
-    auto output_file = File::open_file(argv[3], File::WRITE);
+    auto output_file = File::open_file(argv[3], File::WRITE, File::BUFFERED);
     moderndbs::external_sort(
         *input_file, input_file->size() / sizeof(uint64_t), *output_file, mem_size
     );
+    output_file->sync();
     return 0;
 }
 